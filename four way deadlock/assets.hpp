@@ -0,0 +1,161 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+// Startup asset loading. Every image is decoded, and the ones that take part
+// in collisions get their mask built, on a pool of worker threads; only the
+// texture uploads, which need the OpenGL context, run afterwards on the thread
+// that called load(). Any other texture that ends up in a collision test gets
+// its mask from the bitmask manager on first use.
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <map>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "collision.hpp"
+
+class AssetLoader
+{
+    public:
+        AssetLoader() : decodeSeconds(0), uploadSeconds(0), threadCount(0) {}
+
+        /// All .png and .gif files below a directory, in a stable order
+        static std::vector<std::string> findImages(const std::string& directory)
+        {
+            std::vector<std::string> files;
+            std::error_code error;
+            for (std::filesystem::recursive_directory_iterator entry(directory, error), end; !error && entry != end; entry.increment(error))
+            {
+                std::string extension = entry->path().extension().string();
+                if (entry->is_regular_file() && (extension == ".png" || extension == ".gif"))
+                    files.push_back(entry->path().generic_string());
+            }
+            std::sort(files.begin(), files.end());
+            return files;
+        }
+
+        /// Files below one of the masked directories also get a collision mask.
+        /// Returns false if any file failed to load; the others are still usable
+        bool load(const std::vector<std::string>& files, const std::vector<std::string>& masked, unsigned threads = 0)
+        {
+            typedef std::chrono::steady_clock SteadyClock;
+            SteadyClock::time_point start = SteadyClock::now();
+
+            std::vector<std::unique_ptr<Asset> > pending;
+            for (const std::string& file : files)
+            {
+                pending.push_back(std::unique_ptr<Asset>(new Asset));
+                pending.back()->file = file;
+                for (const std::string& directory : masked)
+                {
+                    if (file.compare(0, directory.size(), directory) == 0)
+                        pending.back()->collides = true;
+                }
+            }
+
+            threadCount = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+            threadCount = std::min<unsigned>(threadCount, std::max<std::size_t>(pending.size(), 1));
+
+            std::atomic<std::size_t> next(0);
+            auto decode = [&]()
+            {
+                for (std::size_t job = next++; job < pending.size(); job = next++)
+                    pending[job]->decode();
+            };
+
+            std::vector<std::thread> pool;
+            for (unsigned index = 1; index < threadCount; index++)
+                pool.push_back(std::thread(decode));
+            decode();
+            for (std::thread& thread : pool)
+                thread.join();
+
+            SteadyClock::time_point decoded = SteadyClock::now();
+
+            bool loaded = true;
+            for (std::unique_ptr<Asset>& asset : pending)
+            {
+                if (!asset->upload())
+                {
+                    loaded = false;
+                    continue;
+                }
+                byName[asset->file] = asset.get();
+                assets.push_back(std::move(asset));
+            }
+
+            decodeSeconds = std::chrono::duration<double>(decoded - start).count();
+            uploadSeconds = std::chrono::duration<double>(SteadyClock::now() - decoded).count();
+            return loaded;
+        }
+
+        /// A texture uploaded by load(), or null if the file was not part of it
+        const sf::Texture* getTexture(const std::string& file) const
+        {
+            std::map<std::string, Asset*>::const_iterator found = byName.find(file);
+            return found == byName.end() ? 0 : &found->second->texture;
+        }
+
+        /// Id of the collision mask built for the texture, invalid if the file was not part of load() or not masked
+        Collision::MaskId getMask(const std::string& file) const
+        {
+            std::map<std::string, Asset*>::const_iterator found = byName.find(file);
+            return found == byName.end() ? Collision::MaskId() : found->second->maskId;
+        }
+
+        std::size_t size() const { return assets.size(); }
+
+        double decodeSeconds;
+        double uploadSeconds;
+        unsigned threadCount;
+
+    private:
+        struct Asset
+        {
+            std::string file;
+            sf::Image image;
+            std::vector<sf::Uint8> mask;
+            bool decoded = false;
+            bool collides = false;
+            sf::Texture texture;
+            Collision::MaskId maskId;
+
+            ~Asset() { Collision::Bitmasks.Release(&texture); }
+
+            void decode()
+            {
+                decoded = image.loadFromFile(file);
+                if (!decoded || !collides)
+                    return;
+
+                sf::Vector2u size = image.getSize();
+                const sf::Uint8* pixels = image.getPixelsPtr();
+                mask.resize(size.x * size.y);
+                for (unsigned int index = 0; index < size.x * size.y; index++)
+                    mask[index] = pixels[index * 4 + 3];
+            }
+
+            bool upload()
+            {
+                if (!decoded || !texture.loadFromImage(image))
+                    return false;
+
+                if (collides)
+                    maskId = Collision::Bitmasks.StoreMask(&texture, mask.data());
+                mask = std::vector<sf::Uint8>();
+                image = sf::Image();
+                return true;
+            }
+        };
+
+        std::vector<std::unique_ptr<Asset> > assets;
+        std::map<std::string, Asset*> byName;
+};
+
+#endif // ASSETS_H
@@ -0,0 +1,224 @@
+// Monte-Carlo batch runner: steps many seeded, headless copies of the
+// crossroad in parallel and writes one CSV row per parameter point.
+//
+//   sfmldemo-batch --runs 2000 --rates 0.25,0.5,1 --mixes 0,0.2 --policies 0,1 --out sweep.csv
+
+#include "simulation.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <cmath>
+
+using namespace Simulation;
+
+struct Options
+{
+    int runs = 1000;
+    int ticks = 3600;
+    int green = 240;
+    int clearance = 120;
+    float exitRate = 0.f;
+    float horizon = 0.f;
+    bool fromReset = true;
+    std::uint64_t seed = 1;
+    unsigned threads = 0;
+    std::vector<float> rates = { 0.25f, 0.5f, 1.f };
+    std::vector<float> mixes = { 0.f, 0.2f };
+    std::vector<int> policies = { NoLights, FixedCycle };
+    std::string out = "batch.csv";
+};
+
+struct Point
+{
+    float rate;
+    float mix;
+    int policy;
+};
+
+template <typename T>
+std::vector<T> parseList(const std::string& text)
+{
+    std::vector<T> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        values.push_back(T(std::atof(item.c_str())));
+    return values;
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int index = 1; index < argc; index++)
+    {
+        std::string arg = argv[index];
+        if (index + 1 >= argc)
+        {
+            std::cout<<"Missing value for "<<arg<<std::endl;
+            return false;
+        }
+        std::string value = argv[++index];
+
+        if (arg == "--runs")
+            options.runs = std::atoi(value.c_str());
+        else if (arg == "--ticks")
+            options.ticks = std::atoi(value.c_str());
+        else if (arg == "--green")
+            options.green = std::atoi(value.c_str());
+        else if (arg == "--clearance")
+            options.clearance = std::atoi(value.c_str());
+        else if (arg == "--exit-rate")
+            options.exitRate = float(std::atof(value.c_str()));
+        else if (arg == "--horizon")
+            options.horizon = float(std::atof(value.c_str()));
+        else if (arg == "--from-reset")
+            options.fromReset = std::atoi(value.c_str()) != 0;
+        else if (arg == "--seed")
+            options.seed = std::strtoull(value.c_str(), 0, 10);
+        else if (arg == "--threads")
+            options.threads = std::atoi(value.c_str());
+        else if (arg == "--rates")
+            options.rates = parseList<float>(value);
+        else if (arg == "--mixes")
+            options.mixes = parseList<float>(value);
+        else if (arg == "--policies")
+            options.policies = parseList<int>(value);
+        else if (arg == "--out")
+            options.out = value;
+        else
+        {
+            std::cout<<"Unknown option "<<arg<<std::endl;
+            return false;
+        }
+    }
+    return options.runs > 0 && options.ticks > 0;
+}
+
+/// Every run gets its own stream derived from the base seed, the point and the run number,
+/// so the results do not depend on the thread count or on scheduling
+std::uint64_t runSeed(std::uint64_t base, std::size_t point, int run)
+{
+    Random mixer(base ^ (std::uint64_t(point) << 32) ^ std::uint64_t(run));
+    return mixer.next();
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cout<<"Usage: "<<argv[0]<<" [--runs N] [--ticks N] [--green N] [--clearance N] [--exit-rate N] [--horizon ticks] [--from-reset 0|1]"
+                 <<" [--seed N] [--threads N]"
+                 <<" [--rates a,b] [--mixes a,b] [--policies 0,1] [--out file.csv]"<<std::endl;
+        return 1;
+    }
+
+    std::vector<Point> points;
+    for (int policy : options.policies)
+        for (float rate : options.rates)
+            for (float mix : options.mixes)
+                points.push_back(Point{ rate, mix, policy });
+
+    std::size_t total = points.size() * options.runs;
+    std::vector<RunResult> results(total);
+    std::atomic<std::size_t> next(0);
+
+    unsigned threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+
+    auto worker = [&]()
+    {
+        for (std::size_t job = next++; job < total; job = next++)
+        {
+            const Point& point = points[job / options.runs];
+            Parameters params;
+            params.arrivalRate = point.rate;
+            params.speedMix = point.mix;
+            params.lightPolicy = point.policy;
+            params.maxTicks = options.ticks;
+            params.greenTicks = options.green;
+            params.clearanceTicks = options.clearance;
+            params.exitRate = options.exitRate;
+            params.forecastHorizon = options.horizon;
+            params.startFromReset = options.fromReset;
+
+            World world(params, runSeed(options.seed, job / options.runs, int(job % options.runs)));
+            results[job] = world.run();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned index = 0; index < threads; index++)
+        pool.push_back(std::thread(worker));
+    for (std::thread& thread : pool)
+        thread.join();
+
+    std::ofstream csv(options.out.c_str());
+    if (!csv)
+    {
+        std::cout<<"Error occoured!, failed to open "<<options.out<<std::endl;
+        return 1;
+    }
+
+    csv<<"policy,green_ticks,clearance_ticks,exit_rate,from_reset,arrival_rate,speed_mix,runs,deadlocks,deadlock_probability,probability_stderr,"
+       <<"mean_seconds_to_first_deadlock,mean_throughput,forecast_horizon,forecast_recall,"
+       <<"mean_forecast_lead_seconds,forecast_false_alarm_rate\n";
+
+    for (std::size_t index = 0; index < points.size(); index++)
+    {
+        int deadlocks = 0, forecasted = 0, falseAlarms = 0;
+        double firstDeadlock = 0, throughput = 0, lead = 0;
+        for (int run = 0; run < options.runs; run++)
+        {
+            const RunResult& result = results[index * options.runs + run];
+            if (result.deadlocked)
+            {
+                deadlocks++;
+                firstDeadlock += result.firstDeadlockTick / TicksPerSecond;
+
+                // Only a prediction that still stands at the deadlock and was made within the horizon counts
+                int ahead = result.firstDeadlockTick - result.forecastSince;
+                if (result.forecastSince >= 0 && ahead > 0 && ahead <= options.horizon)
+                {
+                    forecasted++;
+                    lead += ahead / TicksPerSecond;
+                }
+            }
+            else if (result.firstForecastTick >= 0)
+                falseAlarms++;
+            throughput += result.throughput();
+        }
+
+        double probability = double(deadlocks) / options.runs;
+        csv<<points[index].policy<<','<<options.green<<','<<options.clearance<<','<<options.exitRate<<','<<options.fromReset<<','<<points[index].rate<<','<<points[index].mix<<','
+           <<options.runs<<','<<deadlocks<<','<<probability<<','
+           <<std::sqrt(probability * (1 - probability) / options.runs)<<',';
+        if (deadlocks)
+            csv<<firstDeadlock / deadlocks;
+        csv<<','<<throughput / options.runs<<','<<options.horizon<<',';
+        if (options.horizon > 0)
+        {
+            if (deadlocks)
+                csv<<double(forecasted) / deadlocks;
+            csv<<',';
+            if (forecasted)
+                csv<<lead / forecasted;
+            csv<<',';
+            if (deadlocks < options.runs)
+                csv<<double(falseAlarms) / (options.runs - deadlocks);
+        }
+        else
+            csv<<",,";
+        csv<<'\n';
+    }
+
+    std::cout<<points.size()<<" points x "<<options.runs<<" runs on "<<threads
+             <<" threads written to "<<options.out<<std::endl;
+    return 0;
+}
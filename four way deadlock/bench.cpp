@@ -0,0 +1,418 @@
+// Headless scaling benchmark: runs the main loop phases of the crossroad at
+// growing vehicle counts and writes one CSV row per scenario.
+//
+//   sfmldemo-bench --vehicles 10,100,1000,10000,100000 --ticks 600 --out bench.csv
+//
+// A scenario tiles as many crossroads as it needs side by side, each holding
+// up to --per-tile cars, and times every tick in the order main() runs it:
+// update, broad phase, narrow phase, deadlock check and draw list. Like the
+// snapshots of main(), the draw grid persists between ticks: cars that moved
+// are updated in it, cars that left are removed, and the view only queries it.
+
+#include "simulation.hpp"
+#include "spatialgrid.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <utility>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+
+#if defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#   include <sys/resource.h>
+#endif
+
+using namespace Simulation;
+
+typedef std::chrono::steady_clock SteadyClock;
+
+struct Options
+{
+    std::vector<int> vehicles = { 10, 100, 1000, 10000, 100000 };
+    int ticks = 600;
+    int warmup = 300;
+    int perTile = 10;
+    int policy = FixedCycle;
+    double maxSeconds = 30;
+    std::uint64_t seed = 1;
+    std::string out = "bench.csv";
+};
+
+enum Phase { Update, BroadPhase, NarrowPhase, DeadlockCheck, DrawList, PhaseCount };
+
+const char* PhaseNames[PhaseCount] = { "update", "broad_phase", "narrow_phase", "deadlock_check", "draw_list" };
+
+struct Result
+{
+    int target;
+    int tiles;
+    int ticks = 0;
+    double vehicles = 0;       // mean over the measured ticks
+    double seconds = 0;
+    double phaseSeconds[PhaseCount] = {};
+    std::uint64_t pairs = 0;
+    std::uint64_t contacts = 0;
+    int deadlocks = 0;
+    long peakRssKb = -1;
+};
+
+/// The car images: opaque body, transparent border and rounded corners
+struct Mask
+{
+    int size;
+    std::vector<std::uint8_t> alpha;
+
+    explicit Mask(int size, int border) : size(size), alpha(size * size, 0)
+    {
+        float half = size / 2.f - border, corner = 8.f;
+        for (int y = 0; y < size; y++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                float dx = std::max(std::fabs(x + 0.5f - size / 2.f) - (half - corner), 0.f);
+                float dy = std::max(std::fabs(y + 0.5f - size / 2.f) - (half - corner), 0.f);
+                if (dx * dx + dy * dy <= corner * corner)
+                    alpha[y * size + x] = 255;
+            }
+        }
+    }
+
+    /// Axis aligned overlap of two copies, the second one offset by (offsetX, offsetY)
+    bool overlaps(int offsetX, int offsetY) const
+    {
+        int left = std::max(0, offsetX), right = std::min(size, size + offsetX);
+        int top = std::max(0, offsetY), bottom = std::min(size, size + offsetY);
+        for (int y = top; y < bottom; y++)
+        {
+            for (int x = left; x < right; x++)
+            {
+                if (alpha[y * size + x] && alpha[(y - offsetY) * size + x - offsetX])
+                    return true;
+            }
+        }
+        return false;
+    }
+};
+
+template <typename T>
+std::vector<T> parseList(const std::string& text)
+{
+    std::vector<T> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        values.push_back(T(std::atof(item.c_str())));
+    return values;
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int index = 1; index < argc; index++)
+    {
+        std::string arg = argv[index];
+        if (index + 1 >= argc)
+        {
+            std::cout<<"Missing value for "<<arg<<std::endl;
+            return false;
+        }
+        std::string value = argv[++index];
+
+        if (arg == "--vehicles")
+            options.vehicles = parseList<int>(value);
+        else if (arg == "--ticks")
+            options.ticks = std::atoi(value.c_str());
+        else if (arg == "--warmup")
+            options.warmup = std::atoi(value.c_str());
+        else if (arg == "--per-tile")
+            options.perTile = std::atoi(value.c_str());
+        else if (arg == "--policy")
+            options.policy = std::atoi(value.c_str());
+        else if (arg == "--max-seconds")
+            options.maxSeconds = std::atof(value.c_str());
+        else if (arg == "--seed")
+            options.seed = std::strtoull(value.c_str(), 0, 10);
+        else if (arg == "--out")
+            options.out = value;
+        else
+        {
+            std::cout<<"Unknown option "<<arg<<std::endl;
+            return false;
+        }
+    }
+    return options.ticks > 0 && options.perTile > 0 && !options.vehicles.empty();
+}
+
+/// Starts a new peak RSS measurement; Linux only, elsewhere the peak covers the whole process
+void resetPeakRss()
+{
+    if (std::FILE* file = std::fopen("/proc/self/clear_refs", "w"))
+    {
+        std::fputs("5", file);
+        std::fclose(file);
+    }
+}
+
+long peakRssKb()
+{
+    if (std::FILE* file = std::fopen("/proc/self/status", "r"))
+    {
+        char line[256];
+        long peak = -1;
+        while (std::fgets(line, sizeof(line), file))
+        {
+            if (std::sscanf(line, "VmHWM: %ld", &peak) == 1)
+                break;
+        }
+        std::fclose(file);
+        if (peak >= 0)
+            return peak;
+    }
+#if defined(__unix__) || defined(__unix) || defined(__APPLE__)
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+    #if defined(__APPLE__)
+        return long(usage.ru_maxrss / 1024);
+    #else
+        return long(usage.ru_maxrss);
+    #endif
+    }
+#endif
+    return -1;
+}
+
+double secondsSince(SteadyClock::time_point start)
+{
+    return std::chrono::duration<double>(SteadyClock::now() - start).count();
+}
+
+Result runScenario(const Options& options, int target)
+{
+    const float tileWidth = 800, tileHeight = 700;
+
+    Result result;
+    result.target = target;
+    result.tiles = (target + options.perTile - 1) / options.perTile;
+    resetPeakRss();
+
+    Parameters params;
+    params.arrivalRate = 2.f;
+    params.lightPolicy = options.policy;
+    params.maxTicks = options.warmup + options.ticks;
+    params.startFromReset = false;
+
+    std::vector<World> tiles;
+    tiles.reserve(result.tiles);
+    int columns = int(std::ceil(std::sqrt(double(result.tiles))));
+    for (int tile = 0; tile < result.tiles; tile++)
+    {
+        params.maxVehicles = std::min(options.perTile, target - tile * options.perTile);
+        Random mixer(options.seed ^ (std::uint64_t(target) << 32) ^ std::uint64_t(tile));
+        tiles.push_back(World(params, mixer.next()));
+    }
+    Spatial::Box world = { -VehicleSize, -VehicleSize, columns * tileWidth, ((result.tiles + columns - 1) / columns) * tileHeight };
+
+    Mask mask(int(VehicleSize), int(params.collisionInset));
+    Spatial::Grid grid(128), drawGrid(128);
+    std::vector<Vehicle> lane, vehicles;
+    std::vector<int> candidates, visible;
+
+    // Slots in the draw grid stay with a car while it lives, as the object ids do in main()
+    const std::uint64_t Free = ~std::uint64_t(0);
+    std::vector<std::uint64_t> keys, ownerOf;
+    std::unordered_map<std::uint64_t, int> slotOf;
+    std::vector<int> slots, freeSlots, gone;
+    std::vector<int> seenAt;
+    std::vector<std::pair<int, int> > pairs;
+    std::vector<Spatial::Box> drawList;
+
+    SteadyClock::time_point start = SteadyClock::now();
+    for (int tick = 0; tick < options.warmup + options.ticks; tick++)
+    {
+        bool measured = tick >= options.warmup;
+        if (measured && tick == options.warmup)
+            start = SteadyClock::now();
+        SteadyClock::time_point phaseStart = SteadyClock::now();
+        double phase[PhaseCount];
+
+        for (World& crossroad : tiles)
+            crossroad.advance();
+        phase[Update] = secondsSince(phaseStart);
+
+        // Broad phase: every car of every tile in one grid, candidates are overlapping boxes
+        phaseStart = SteadyClock::now();
+        vehicles.clear();
+        keys.clear();
+        for (int tile = 0; tile < result.tiles; tile++)
+        {
+            tiles[tile].collectVehicles(lane);
+            float offsetX = (tile % columns) * tileWidth, offsetY = (tile / columns) * tileHeight;
+            for (Vehicle& vehicle : lane)
+            {
+                vehicle.x += offsetX;
+                vehicle.y += offsetY;
+                vehicles.push_back(vehicle);
+                keys.push_back((std::uint64_t(tile) << 32) | std::uint32_t(vehicle.id));
+            }
+        }
+        grid.clear();
+        for (std::size_t index = 0; index < vehicles.size(); index++)
+        {
+            Spatial::Box box = { vehicles[index].x, vehicles[index].y, VehicleSize, VehicleSize };
+            grid.insert(int(index), box);
+        }
+        pairs.clear();
+        for (std::size_t index = 0; index < vehicles.size(); index++)
+        {
+            grid.query(grid.getBox(int(index)), candidates);
+            for (int other : candidates)
+            {
+                if (other > int(index))
+                    pairs.push_back(std::make_pair(int(index), other));
+            }
+        }
+        phase[BroadPhase] = secondsSince(phaseStart);
+
+        phaseStart = SteadyClock::now();
+        std::uint64_t contacts = 0;
+        for (const std::pair<int, int>& pair : pairs)
+        {
+            const Vehicle& first = vehicles[pair.first];
+            const Vehicle& second = vehicles[pair.second];
+            if (mask.overlaps(int(std::lround(second.x - first.x)), int(std::lround(second.y - first.y))))
+                contacts++;
+        }
+        phase[NarrowPhase] = secondsSince(phaseStart);
+
+        // A deadlocked crossroad starts over, so the vehicle count stays up
+        phaseStart = SteadyClock::now();
+        int deadlocks = 0;
+        for (World& crossroad : tiles)
+        {
+            if (crossroad.checkDeadlock())
+            {
+                crossroad.reset();
+                deadlocks++;
+            }
+        }
+        phase[DeadlockCheck] = secondsSince(phaseStart);
+
+        // Stable slots come for free in main(), so finding them is left out of the timing
+        slots.resize(vehicles.size());
+        for (std::size_t index = 0; index < vehicles.size(); index++)
+        {
+            std::unordered_map<std::uint64_t, int>::iterator found = slotOf.find(keys[index]);
+            int slot;
+            if (found != slotOf.end())
+                slot = found->second;
+            else
+            {
+                if (freeSlots.empty())
+                {
+                    slot = int(ownerOf.size());
+                    ownerOf.push_back(Free);
+                    seenAt.push_back(-1);
+                }
+                else
+                {
+                    slot = freeSlots.back();
+                    freeSlots.pop_back();
+                }
+                ownerOf[slot] = keys[index];
+                slotOf[keys[index]] = slot;
+            }
+            slots[index] = slot;
+            seenAt[slot] = tick;
+        }
+        gone.clear();
+        for (std::size_t slot = 0; slot < ownerOf.size(); slot++)
+        {
+            if (ownerOf[slot] != Free && seenAt[slot] != tick)
+            {
+                slotOf.erase(ownerOf[slot]);
+                ownerOf[slot] = Free;
+                freeSlots.push_back(int(slot));
+                gone.push_back(int(slot));
+            }
+        }
+
+        // Draw list with the camera zoomed out over every tile
+        phaseStart = SteadyClock::now();
+        for (int slot : gone)
+            drawGrid.remove(slot);
+        for (std::size_t index = 0; index < vehicles.size(); index++)
+            drawGrid.update(slots[index], grid.getBox(int(index)));
+        drawGrid.query(world, visible);
+        std::sort(visible.begin(), visible.end());
+        drawList.clear();
+        for (int id : visible)
+            drawList.push_back(drawGrid.getBox(id));
+        phase[DrawList] = secondsSince(phaseStart);
+
+        if (!measured)
+            continue;
+
+        result.ticks++;
+        result.vehicles += double(vehicles.size());
+        for (int index = 0; index < PhaseCount; index++)
+            result.phaseSeconds[index] += phase[index];
+        result.pairs += pairs.size();
+        result.contacts += contacts;
+        result.deadlocks += deadlocks;
+        if (secondsSince(start) >= options.maxSeconds)
+            break;
+    }
+
+    result.seconds = secondsSince(start);
+    if (result.ticks)
+        result.vehicles /= result.ticks;
+    result.peakRssKb = peakRssKb();
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cout<<"Usage: "<<argv[0]<<" [--vehicles 10,100,1000] [--ticks N] [--warmup N] [--per-tile N] [--policy 0|1]"
+                 <<" [--max-seconds N] [--seed N] [--out file.csv]"<<std::endl;
+        return 1;
+    }
+
+    std::ofstream csv(options.out.c_str());
+    if (!csv)
+    {
+        std::cout<<"Error occoured!, failed to open "<<options.out<<std::endl;
+        return 1;
+    }
+
+    csv<<"target_vehicles,tiles,mean_vehicles,ticks,ticks_per_second";
+    for (int index = 0; index < PhaseCount; index++)
+        csv<<','<<PhaseNames[index]<<"_ms";
+    csv<<",pairs_per_tick,contacts_per_tick,deadlocks,peak_rss_kb\n";
+
+    for (int target : options.vehicles)
+    {
+        Result result = runScenario(options, target);
+        double ticks = std::max(result.ticks, 1);
+
+        csv<<result.target<<','<<result.tiles<<','<<result.vehicles<<','<<result.ticks<<','<<result.ticks / result.seconds;
+        for (int index = 0; index < PhaseCount; index++)
+            csv<<','<<result.phaseSeconds[index] * 1000 / ticks;
+        csv<<','<<result.pairs / ticks<<','<<result.contacts / ticks<<','<<result.deadlocks<<','<<result.peakRssKb<<'\n';
+        csv.flush();
+
+        std::cout<<result.target<<" vehicles: "<<result.ticks / result.seconds<<" ticks/s, peak RSS "
+                 <<result.peakRssKb<<" kB"<<std::endl;
+    }
+    return 0;
+}
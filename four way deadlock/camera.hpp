@@ -0,0 +1,79 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+// sf::View based camera: the mouse wheel zooms around the cursor, the arrow
+// keys pan while the window has the focus and Home goes back to the whole
+// crossroad.
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+
+#include "spatialgrid.hpp"
+
+class Camera
+{
+    public:
+        Camera(float width, float height)
+            : home(sf::FloatRect(0, 0, width, height)), view(home), zoomLevel(1.f)
+        {
+        }
+
+        void handleEvent(const sf::Event& event, const sf::RenderWindow& window)
+        {
+            if (event.type == sf::Event::MouseWheelScrolled && event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel)
+            {
+                float factor = event.mouseWheelScroll.delta > 0 ? 0.9f : 1.f / 0.9f;
+                if (zoomLevel * factor < 0.1f || zoomLevel * factor > 20.f)
+                    return;
+
+                // Keep the point under the cursor where it is
+                sf::Vector2i pixel(event.mouseWheelScroll.x, event.mouseWheelScroll.y);
+                sf::Vector2f before = window.mapPixelToCoords(pixel, view);
+                view.zoom(factor);
+                zoomLevel *= factor;
+                sf::Vector2f after = window.mapPixelToCoords(pixel, view);
+                view.move(before.x - after.x, before.y - after.y);
+            }
+            else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Home)
+            {
+                view = home;
+                zoomLevel = 1.f;
+            }
+        }
+
+        /// Pan with the arrow keys, at a speed that feels the same at every zoom level. The keyboard
+        /// state is global, so keys typed into the console must not move the view
+        void update(float seconds, const sf::RenderWindow& window)
+        {
+            if (!window.hasFocus())
+                return;
+
+            float step = 400.f * zoomLevel * seconds;
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))
+                view.move(-step, 0);
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right))
+                view.move(step, 0);
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up))
+                view.move(0, -step);
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down))
+                view.move(0, step);
+        }
+
+        const sf::View& getView() const { return view; }
+
+        /// The part of the world that ends up in the window
+        Spatial::Box visibleArea() const
+        {
+            sf::Vector2f center = view.getCenter();
+            sf::Vector2f size = view.getSize();
+            Spatial::Box area = { center.x - size.x / 2, center.y - size.y / 2, size.x, size.y };
+            return area;
+        }
+
+    private:
+        sf::View home;
+        sf::View view;
+        float zoomLevel;
+};
+
+#endif // CAMERA_H
@@ -0,0 +1,670 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <unordered_map>
+#include <list>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace Collision {
+
+    inline bool PixelPerfectTest(const sf::Sprite& Object1 ,const sf::Sprite& Object2, sf::Uint8 AlphaLimit = 0);
+
+    struct MaskId;
+
+    inline bool PixelPerfectTest(const sf::Sprite& Object1, MaskId Mask1, const sf::Sprite& Object2, MaskId Mask2, sf::Uint8 AlphaLimit = 0);
+
+    inline bool CreateTextureAndBitmask(sf::Texture &LoadInto, const std::string& Filename);
+
+    inline bool CircleTest(const sf::Sprite& Object1, const sf::Sprite& Object2);
+
+    inline bool BoundingBoxTest(const sf::Sprite& Object1, const sf::Sprite& Object2);
+
+    template <class Shape1, class Shape2>
+    inline bool CascadeTest(const sf::Sprite& Object1, const sf::Sprite& Object2, sf::Uint8 AlphaLimit = 0);
+
+    template <class Shape1, class Shape2>
+    inline bool CascadeTest(const sf::Sprite& Object1, MaskId Mask1, const sf::Sprite& Object2, MaskId Mask2, sf::Uint8 AlphaLimit = 0);
+}
+
+
+namespace Collision
+{
+    struct MaskId // Stable slot of a texture plus the generation of the image it held when the id was handed out
+    {
+        MaskId() : Index(0xffffffff), Generation(0) {}
+
+        std::uint32_t Index, Generation;
+    };
+
+    class BitmaskManager // All masks live in one arena, a slot per texture points into it
+    {
+    public:
+        BitmaskManager() : Hits(0), Misses(0), Garbage(0) {}
+
+        sf::Uint8 GetPixel (const sf::Uint8* mask, const sf::Texture* tex, unsigned int x, unsigned int y) {
+            if (x>tex->getSize().x||y>tex->getSize().y)
+                return 0;
+
+            return mask[x+y*tex->getSize().x];
+        }
+
+        // A current id for the texture, building its mask if there is none. A valid id is a plain vector index;
+        // a stale or missing one falls back to looking the texture up
+        MaskId Find (const sf::Texture* tex, MaskId Id = MaskId()) {
+            if (Id.Index<Slots.size() && Slots[Id.Index].Texture==tex && Slots[Id.Index].Generation==Id.Generation && Slots[Id.Index].Built)
+            {
+                Hits++;
+                return Id;
+            }
+
+            std::unordered_map<const sf::Texture*, std::uint32_t>::const_iterator Found = Indices.find(tex);
+            if (Found!=Indices.end() && Slots[Found->second].Built)
+            {
+                Hits++;
+                return Current(Found->second);
+            }
+
+            Misses++;
+            sf::Image img = tex->copyToImage();
+            return CreateMask (tex, img);
+        }
+
+        // Only valid until the next mask is built, the arena may move
+        const sf::Uint8* GetMask (MaskId Id) const {
+            return &Arena[Slots[Id.Index].Offset];
+        }
+
+        const sf::Uint8* GetMask (const sf::Texture* tex) {
+            return GetMask(Find(tex));
+        }
+
+        MaskId CreateMask (const sf::Texture* tex, const sf::Image& img) {
+            std::uint32_t Index = Reserve(tex);
+            sf::Uint8* mask = &Arena[Slots[Index].Offset];
+
+            for (unsigned int y = 0; y<tex->getSize().y; y++)
+            {
+                for (unsigned int x = 0; x<tex->getSize().x; x++)
+                    mask[x+y*tex->getSize().x] = img.getPixel(x,y).a;
+            }
+
+            return Current(Index);
+        }
+
+        MaskId StoreMask (const sf::Texture* tex, const sf::Uint8* alpha) { // Copies a mask built elsewhere
+            std::uint32_t Index = Reserve(tex);
+            std::copy(alpha, alpha+Slots[Index].Size, Arena.begin()+Slots[Index].Offset);
+            return Current(Index);
+        }
+
+        void Invalidate (const sf::Texture* tex) { // The texture got a new image, ids handed out so far go stale
+            std::unordered_map<const sf::Texture*, std::uint32_t>::const_iterator Found = Indices.find(tex);
+            if (Found==Indices.end())
+                return;
+            Slot& Entry = Slots[Found->second];
+            Entry.Generation++;
+            Entry.Built = false;
+            Garbage += Entry.Size;
+            Entry.Size = 0;
+        }
+
+        void Release (const sf::Texture* tex) { // The texture is gone, another one may get its address
+            Invalidate(tex);
+            Indices.erase(tex);
+        }
+
+        std::size_t GetMaskBytes() const { return Arena.size()-Garbage; }
+        std::size_t GetArenaBytes() const { return Arena.capacity(); }
+
+        unsigned long Hits, Misses;
+
+    private:
+        struct Slot
+        {
+            const sf::Texture* Texture;
+            std::uint32_t Generation;
+            bool Built;
+            std::size_t Offset, Size;
+        };
+
+        MaskId Current (std::uint32_t Index) const {
+            MaskId Id;
+            Id.Index = Index;
+            Id.Generation = Slots[Index].Generation;
+            return Id;
+        }
+
+        // Slot of the texture with room for its mask, under a new generation
+        std::uint32_t Reserve (const sf::Texture* tex) {
+            std::unordered_map<const sf::Texture*, std::uint32_t>::const_iterator Found = Indices.find(tex);
+            std::uint32_t Index;
+            if (Found!=Indices.end())
+                Index = Found->second;
+            else
+            {
+                Index = std::uint32_t(Slots.size());
+                Slots.push_back(Slot{ tex, 0, false, 0, 0 });
+                Indices[tex] = Index;
+            }
+
+            Slot& Entry = Slots[Index];
+            std::size_t Size = std::size_t(tex->getSize().x)*tex->getSize().y;
+            Entry.Generation++;
+            Entry.Built = true;
+            if (Entry.Size!=Size)
+            {
+                Garbage += Entry.Size;
+                Entry.Size = 0;
+                if (Garbage>Arena.size()/2)
+                    Compact();
+                Entry.Offset = Arena.size();
+                Entry.Size = Size;
+                Arena.resize(Arena.size()+Size);
+            }
+            return Index;
+        }
+
+        // Slide the live masks down over the ones that were replaced or released
+        void Compact () {
+            std::vector<std::uint32_t> Order;
+            for (std::uint32_t Index = 0; Index<Slots.size(); Index++)
+            {
+                if (Slots[Index].Size)
+                    Order.push_back(Index);
+            }
+            std::sort(Order.begin(), Order.end(), [this](std::uint32_t A, std::uint32_t B) { return Slots[A].Offset<Slots[B].Offset; });
+
+            std::size_t End = 0;
+            for (std::uint32_t Index : Order)
+            {
+                Slot& Entry = Slots[Index];
+                std::copy(Arena.begin()+Entry.Offset, Arena.begin()+Entry.Offset+Entry.Size, Arena.begin()+End);
+                Entry.Offset = End;
+                End += Entry.Size;
+            }
+            Arena.resize(End);
+            Garbage = 0;
+        }
+
+        std::vector<sf::Uint8> Arena;
+        std::size_t Garbage;
+        std::vector<Slot> Slots;
+        std::unordered_map<const sf::Texture*, std::uint32_t> Indices;
+    };
+
+    inline BitmaskManager Bitmasks;
+
+    inline bool PixelPerfectTest(const sf::Sprite& Object1, const sf::Sprite& Object2, sf::Uint8 AlphaLimit) {
+        return PixelPerfectTest(Object1, MaskId(), Object2, MaskId(), AlphaLimit);
+    }
+
+    inline bool PixelPerfectTest(const sf::Sprite& Object1, MaskId Mask1, const sf::Sprite& Object2, MaskId Mask2, sf::Uint8 AlphaLimit) {
+        sf::FloatRect Intersection;
+        if (Object1.getGlobalBounds().intersects(Object2.getGlobalBounds(), Intersection)) {
+            sf::IntRect O1SubRect = Object1.getTextureRect();
+            sf::IntRect O2SubRect = Object2.getTextureRect();
+
+            // Both ids first, building the second mask may move the first one
+            Mask1 = Bitmasks.Find(Object1.getTexture(), Mask1);
+            Mask2 = Bitmasks.Find(Object2.getTexture(), Mask2);
+            const sf::Uint8* mask1 = Bitmasks.GetMask(Mask1);
+            const sf::Uint8* mask2 = Bitmasks.GetMask(Mask2);
+
+            // Loop through our pixels
+            for (int i = Intersection.left; i < Intersection.left+Intersection.width; i++) {
+                for (int j = Intersection.top; j < Intersection.top+Intersection.height; j++) {
+
+                    sf::Vector2f o1v = Object1.getInverseTransform().transformPoint(i, j);
+                    sf::Vector2f o2v = Object2.getInverseTransform().transformPoint(i, j);
+
+                    // Make sure pixels fall within the sprite's subrect
+                    if (o1v.x > 0 && o1v.y > 0 && o2v.x > 0 && o2v.y > 0 &&
+                        o1v.x < O1SubRect.width && o1v.y < O1SubRect.height &&
+                        o2v.x < O2SubRect.width && o2v.y < O2SubRect.height) {
+
+                        if (Bitmasks.GetPixel(mask1, Object1.getTexture(), (int)(o1v.x)+O1SubRect.left, (int)(o1v.y)+O1SubRect.top) > AlphaLimit &&
+                            Bitmasks.GetPixel(mask2, Object2.getTexture(), (int)(o2v.x)+O2SubRect.left, (int)(o2v.y)+O2SubRect.top) > AlphaLimit)
+                            return true;
+
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    inline bool CreateTextureAndBitmask(sf::Texture &LoadInto, const std::string& Filename)
+    {
+        sf::Image img;
+        if (!img.loadFromFile(Filename))
+            return false;
+        if (!LoadInto.loadFromImage(img))
+            return false;
+
+        Bitmasks.CreateMask(&LoadInto, img);
+        return true;
+    }
+
+    inline sf::Vector2f GetSpriteCenter (const sf::Sprite& Object)
+    {
+        sf::FloatRect AABB = Object.getGlobalBounds();
+        return sf::Vector2f (AABB.left+AABB.width/2.f, AABB.top+AABB.height/2.f);
+    }
+
+    inline sf::Vector2f GetSpriteSize (const sf::Sprite& Object)
+    {
+        sf::IntRect OriginalSize = Object.getTextureRect();
+        sf::Vector2f Scale = Object.getScale();
+        return sf::Vector2f (OriginalSize.width*Scale.x, OriginalSize.height*Scale.y);
+    }
+
+    inline bool CircleTest(const sf::Sprite& Object1, const sf::Sprite& Object2) {
+        sf::Vector2f Obj1Size = GetSpriteSize(Object1);
+        sf::Vector2f Obj2Size = GetSpriteSize(Object2);
+        float Radius1 = (Obj1Size.x + Obj1Size.y) / 4;
+        float Radius2 = (Obj2Size.x + Obj2Size.y) / 4;
+
+        sf::Vector2f Distance = GetSpriteCenter(Object1)-GetSpriteCenter(Object2);
+
+        return (Distance.x * Distance.x + Distance.y * Distance.y <= (Radius1 + Radius2) * (Radius1 + Radius2));
+    }
+
+    class OrientedBoundingBox // Used in the BoundingBoxTest
+    {
+    public:
+        OrientedBoundingBox (const sf::Sprite& Object) // Calculate the four points of the OBB from a transformed (scaled, rotated...) sprite
+        {
+            sf::Transform trans = Object.getTransform();
+            sf::IntRect local = Object.getTextureRect();
+            Points[0] = trans.transformPoint(0.f, 0.f);
+            Points[1] = trans.transformPoint(local.width, 0.f);
+            Points[2] = trans.transformPoint(local.width, local.height);
+            Points[3] = trans.transformPoint(0.f, local.height);
+        }
+
+        sf::Vector2f Points[4];
+
+        void ProjectOntoAxis (const sf::Vector2f& Axis, float& Min, float& Max) // Project all four points of the OBB onto the given axis and return the dotproducts of the two outermost points
+        {
+            Min = (Points[0].x*Axis.x+Points[0].y*Axis.y);
+            Max = Min;
+            for (int j = 1; j<4; j++)
+            {
+                float Projection = (Points[j].x*Axis.x+Points[j].y*Axis.y);
+
+                if (Projection<Min)
+                    Min=Projection;
+                if (Projection>Max)
+                    Max=Projection;
+            }
+        }
+    };
+
+    inline bool BoundingBoxTest(const sf::Sprite& Object1, const sf::Sprite& Object2) {
+        OrientedBoundingBox OBB1 (Object1);
+        OrientedBoundingBox OBB2 (Object2);
+
+        // Create the four distinct axes that are perpendicular to the edges of the two rectangles
+        sf::Vector2f Axes[4] = {
+            sf::Vector2f (OBB1.Points[1].x-OBB1.Points[0].x,
+                          OBB1.Points[1].y-OBB1.Points[0].y),
+            sf::Vector2f (OBB1.Points[1].x-OBB1.Points[2].x,
+                          OBB1.Points[1].y-OBB1.Points[2].y),
+            sf::Vector2f (OBB2.Points[0].x-OBB2.Points[3].x,
+                          OBB2.Points[0].y-OBB2.Points[3].y),
+            sf::Vector2f (OBB2.Points[0].x-OBB2.Points[1].x,
+                          OBB2.Points[0].y-OBB2.Points[1].y)
+        };
+
+        for (int i = 0; i<4; i++) // For each axis...
+        {
+            float MinOBB1, MaxOBB1, MinOBB2, MaxOBB2;
+
+            // ... project the points of both OBBs onto the axis ...
+            OBB1.ProjectOntoAxis(Axes[i], MinOBB1, MaxOBB1);
+            OBB2.ProjectOntoAxis(Axes[i], MinOBB2, MaxOBB2);
+
+            // ... and check whether the outermost projected points of both OBBs overlap.
+            // If this is not the case, the Separating Axis Theorem states that there can be no collision between the rectangles
+            if (!((MinOBB2<=MaxOBB1)&&(MaxOBB2>=MinOBB1)))
+                return false;
+        }
+        return true;
+    }
+    class RotatedMaskCache // Masks of sprites turned to whole multiples of Step degrees, built on first use
+    {
+    public:
+        static const int Step = 5;
+        static const int Angles = 360/Step;
+
+        struct Rotated
+        {
+            int Left, Top;              // of the mask, relative to the sprite position
+            int Width, Height;
+            std::vector<sf::Uint8> Alpha;
+
+            std::uint32_t Generation;   // of the image it was sampled from
+        };
+
+        explicit RotatedMaskCache(std::size_t MaxBytes = 4<<20) : Hits(0), Misses(0), Evictions(0), MaxBytes(MaxBytes), Bytes(0) {}
+
+        static int Quantize (float Rotation) {
+            int Angle = int(std::lround(Rotation/Step))%Angles;
+            return Angle<0 ? Angle+Angles : Angle;
+        }
+
+        // The two most recently used masks are never evicted, so both masks of a pair stay valid together.
+        // Sprites sharing a texture but not its rect or origin get entries of their own
+        const Rotated& Get (const sf::Sprite& Object, MaskId Mask) {
+            Mask = Bitmasks.Find(Object.getTexture(), Mask);
+            Key Wanted = { Mask.Index, Quantize(Object.getRotation()), Object.getTextureRect(), Object.getOrigin() };
+            int Angle = Wanted.Angle;
+
+            std::unordered_map<Key, std::list<Entry>::iterator, KeyHash>::iterator Found = Index.find(Wanted);
+            if (Found!=Index.end())
+            {
+                Rotated& Cached = Found->second->second;
+                Entries.splice(Entries.begin(), Entries, Found->second);
+                if (Cached.Generation==Mask.Generation)
+                {
+                    Hits++;
+                    return Cached;
+                }
+                Bytes -= Cached.Alpha.size();
+                Build(Cached, Object, Mask, Angle);
+                Bytes += Cached.Alpha.size();
+                Misses++;
+                return Cached;
+            }
+
+            Misses++;
+            Entries.push_front(Entry(Wanted, Rotated()));
+            Index[Wanted] = Entries.begin();
+            Build(Entries.front().second, Object, Mask, Angle);
+            Bytes += Entries.front().second.Alpha.size();
+
+            while (Bytes>MaxBytes && Entries.size()>2)
+            {
+                Bytes -= Entries.back().second.Alpha.size();
+                Index.erase(Entries.back().first);
+                Entries.pop_back();
+                Evictions++;
+            }
+            return Entries.front().second;
+        }
+
+        void Clear() { Entries.clear(); Index.clear(); Bytes = 0; }
+
+        std::size_t GetBytes() const { return Bytes; }
+
+        unsigned long Hits, Misses, Evictions;
+
+    private:
+        struct Key
+        {
+            std::uint32_t Slot;
+            int Angle;
+            sf::IntRect TextureRect;
+            sf::Vector2f Origin;
+
+            bool operator== (const Key& Other) const {
+                return Slot==Other.Slot && Angle==Other.Angle && TextureRect==Other.TextureRect && Origin==Other.Origin;
+            }
+        };
+
+        struct KeyHash
+        {
+            std::size_t operator() (const Key& Wanted) const {
+                std::size_t Hash = std::hash<std::uint64_t>()((std::uint64_t(Wanted.Slot)<<8)|std::uint64_t(Wanted.Angle));
+                const int Rect[4] = { Wanted.TextureRect.left, Wanted.TextureRect.top, Wanted.TextureRect.width, Wanted.TextureRect.height };
+                for (int Value : Rect)
+                    Hash = Hash*31+std::hash<int>()(Value);
+                return (Hash*31+std::hash<float>()(Wanted.Origin.x))*31+std::hash<float>()(Wanted.Origin.y);
+            }
+        };
+
+        typedef std::pair<Key, Rotated> Entry;
+
+        // Sample the texture mask at the center of every pixel of the rotated bounds
+        static void Build (Rotated& Out, const sf::Sprite& Object, MaskId Mask, int Angle) {
+            sf::IntRect Rect = Object.getTextureRect();
+            sf::Vector2f Origin = Object.getOrigin();
+            float Radians = Angle*Step*3.14159265f/180.f;
+            float Cos = std::cos(Radians), Sin = std::sin(Radians);
+
+            float MinX = 0.f, MinY = 0.f, MaxX = 0.f, MaxY = 0.f;
+            for (int Corner = 0; Corner<4; Corner++)
+            {
+                float X = (Corner&1 ? Rect.width : 0)-Origin.x, Y = (Corner&2 ? Rect.height : 0)-Origin.y;
+                float RotatedX = X*Cos-Y*Sin, RotatedY = X*Sin+Y*Cos;
+                MinX = Corner ? std::min(MinX, RotatedX) : RotatedX;
+                MaxX = Corner ? std::max(MaxX, RotatedX) : RotatedX;
+                MinY = Corner ? std::min(MinY, RotatedY) : RotatedY;
+                MaxY = Corner ? std::max(MaxY, RotatedY) : RotatedY;
+            }
+
+            Out.Left = int(std::floor(MinX));
+            Out.Top = int(std::floor(MinY));
+            Out.Width = int(std::ceil(MaxX))-Out.Left;
+            Out.Height = int(std::ceil(MaxY))-Out.Top;
+            Out.Alpha.assign(std::size_t(Out.Width)*Out.Height, 0);
+            Out.Generation = Mask.Generation;
+
+            const sf::Uint8* Source = Bitmasks.GetMask(Mask);
+            unsigned int Stride = Object.getTexture()->getSize().x;
+            for (int y = 0; y<Out.Height; y++)
+            {
+                for (int x = 0; x<Out.Width; x++)
+                {
+                    float X = Out.Left+x+0.5f, Y = Out.Top+y+0.5f;
+                    float LocalX = X*Cos+Y*Sin+Origin.x, LocalY = -X*Sin+Y*Cos+Origin.y;
+                    if (LocalX>=0.f && LocalY>=0.f && LocalX<Rect.width && LocalY<Rect.height)
+                        Out.Alpha[x+y*Out.Width] = Source[(Rect.left+int(LocalX))+(Rect.top+int(LocalY))*Stride];
+                }
+            }
+        }
+
+        std::size_t MaxBytes, Bytes;
+        std::list<Entry> Entries; // most recently used first
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> Index;
+    };
+
+    inline RotatedMaskCache RotatedMasks;
+
+    // Overlap of two pre-rotated masks placed at whole pixels, no transform per pixel. Sprites that are
+    // scaled take the PixelPerfectTest path instead
+    inline bool AlignedPixelTest(const sf::Sprite& Object1, MaskId Mask1, const sf::Sprite& Object2, MaskId Mask2, sf::Uint8 AlphaLimit) {
+        if (!Object1.getTexture() || !Object2.getTexture())
+            return false;
+        if (Object1.getScale()!=sf::Vector2f(1.f, 1.f) || Object2.getScale()!=sf::Vector2f(1.f, 1.f))
+            return PixelPerfectTest(Object1, Mask1, Object2, Mask2, AlphaLimit);
+
+        const RotatedMaskCache::Rotated& A = RotatedMasks.Get(Object1, Mask1);
+        const RotatedMaskCache::Rotated& B = RotatedMasks.Get(Object2, Mask2);
+        int LeftA = int(std::lround(Object1.getPosition().x))+A.Left, TopA = int(std::lround(Object1.getPosition().y))+A.Top;
+        int LeftB = int(std::lround(Object2.getPosition().x))+B.Left, TopB = int(std::lround(Object2.getPosition().y))+B.Top;
+
+        int Left = std::max(LeftA, LeftB), Right = std::min(LeftA+A.Width, LeftB+B.Width);
+        int Top = std::max(TopA, TopB), Bottom = std::min(TopA+A.Height, TopB+B.Height);
+        for (int y = Top; y<Bottom; y++)
+        {
+            const sf::Uint8* RowA = A.Alpha.data()+(y-TopA)*A.Width+(Left-LeftA);
+            const sf::Uint8* RowB = B.Alpha.data()+(y-TopB)*B.Width+(Left-LeftB);
+            for (int x = 0; x<Right-Left; x++)
+            {
+                if (RowA[x]>AlphaLimit && RowB[x]>AlphaLimit)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // Shape tags, the most precise test a kind of sprite needs. A pair is tested as
+    // precisely as the coarser of its two shapes allows.
+    struct CircleShape { static const int Tier = 0; };
+    struct BoxShape { static const int Tier = 1; };
+    struct PixelShape { static const int Tier = 2; };
+
+    struct CascadeCounters // How many queries ended at each tier
+    {
+        CascadeCounters() : Tests(0), CircleRejects(0), BoxRejects(0), PixelRejects(0), Collisions(0) {}
+
+        unsigned long Tests, CircleRejects, BoxRejects, PixelRejects, Collisions;
+    };
+
+    inline CascadeCounters Cascade;
+
+    inline bool BoundingCircleTest(const sf::Sprite& Object1, const sf::Sprite& Object2) { // Circumscribed circles, never rejects a touching pair
+        sf::Vector2f Obj1Size = GetSpriteSize(Object1);
+        sf::Vector2f Obj2Size = GetSpriteSize(Object2);
+        float Radius1 = std::sqrt(Obj1Size.x * Obj1Size.x + Obj1Size.y * Obj1Size.y) / 2;
+        float Radius2 = std::sqrt(Obj2Size.x * Obj2Size.x + Obj2Size.y * Obj2Size.y) / 2;
+
+        sf::Vector2f Distance = GetSpriteCenter(Object1)-GetSpriteCenter(Object2);
+
+        return (Distance.x * Distance.x + Distance.y * Distance.y <= (Radius1 + Radius2) * (Radius1 + Radius2));
+    }
+
+    template <class Shape1, class Shape2>
+    inline bool CascadeTest(const sf::Sprite& Object1, const sf::Sprite& Object2, sf::Uint8 AlphaLimit) {
+        return CascadeTest<Shape1, Shape2>(Object1, MaskId(), Object2, MaskId(), AlphaLimit);
+    }
+
+    template <class Shape1, class Shape2>
+    inline bool CascadeTest(const sf::Sprite& Object1, MaskId Mask1, const sf::Sprite& Object2, MaskId Mask2, sf::Uint8 AlphaLimit) {
+        constexpr int Tier = Shape1::Tier < Shape2::Tier ? Shape1::Tier : Shape2::Tier;
+        Cascade.Tests++;
+
+        if constexpr (Tier == 0) {
+            if (!CircleTest(Object1, Object2)) {
+                Cascade.CircleRejects++;
+                return false;
+            }
+        }
+        else {
+            if (!BoundingCircleTest(Object1, Object2)) {
+                Cascade.CircleRejects++;
+                return false;
+            }
+            if (!BoundingBoxTest(Object1, Object2)) {
+                Cascade.BoxRejects++;
+                return false;
+            }
+            if constexpr (Tier >= 2) {
+                if (!AlignedPixelTest(Object1, Mask1, Object2, Mask2, AlphaLimit)) {
+                    Cascade.PixelRejects++;
+                    return false;
+                }
+            }
+        }
+        Cascade.Collisions++;
+        return true;
+    }
+
+    class CoherenceCache // Skips the narrow phase for pairs that cannot have touched since their last test
+    {
+    public:
+        CoherenceCache() : Hits(0), Misses(0) {}
+
+        // Same result as CascadeTest; the ids must identify the objects for as long as the cache is used
+        template <class Shape1 = PixelShape, class Shape2 = PixelShape>
+        bool Test(unsigned int Id1, const sf::Sprite& Object1, unsigned int Id2, const sf::Sprite& Object2, sf::Uint8 AlphaLimit = 0,
+                  MaskId Mask1 = MaskId(), MaskId Mask2 = MaskId())
+        {
+            std::uint64_t Key = Id1<Id2 ? (std::uint64_t(Id1)<<32)|Id2 : (std::uint64_t(Id2)<<32)|Id1;
+            const sf::Sprite& First = Id1<Id2 ? Object1 : Object2;
+            const sf::Sprite& Second = Id1<Id2 ? Object2 : Object1;
+
+            std::unordered_map<std::uint64_t, Entry>::iterator Found = Entries.find(Key);
+            if (Found!=Entries.end() && Found->second.StillSeparated(First, Second))
+            {
+                Hits++;
+                return false;
+            }
+            Misses++;
+
+            bool Result = Id1<Id2 ? CascadeTest<Shape1, Shape2>(Object1, Mask1, Object2, Mask2, AlphaLimit)
+                                  : CascadeTest<Shape2, Shape1>(Object2, Mask2, Object1, Mask1, AlphaLimit);
+            Entries[Key].Store(First, Second, Result);
+            return Result;
+        }
+
+        void Clear() { Entries.clear(); }
+
+        unsigned long Hits, Misses;
+
+    private:
+        struct Pose // Everything about a sprite except its position that changes its bounds
+        {
+            const sf::Texture* Texture;
+            sf::IntRect TextureRect;
+            sf::Vector2f Origin, Scale;
+            float Rotation;
+
+            void Store(const sf::Sprite& Object)
+            {
+                Texture = Object.getTexture();
+                TextureRect = Object.getTextureRect();
+                Origin = Object.getOrigin();
+                Scale = Object.getScale();
+                Rotation = Object.getRotation();
+            }
+
+            bool Matches(const sf::Sprite& Object) const
+            {
+                return Texture==Object.getTexture() && TextureRect==Object.getTextureRect() &&
+                       Origin==Object.getOrigin() && Scale==Object.getScale() && Rotation==Object.getRotation();
+            }
+        };
+
+        struct Entry
+        {
+            sf::Vector2f Position1, Position2;
+            Pose Pose1, Pose2;
+            int Axis; // 0 = x, 1 = y, -1 = no separating axis known
+            float Gap;
+
+            void Store(const sf::Sprite& Object1, const sf::Sprite& Object2, bool Collided)
+            {
+                Position1 = Object1.getPosition();
+                Position2 = Object2.getPosition();
+                Pose1.Store(Object1);
+                Pose2.Store(Object2);
+                Axis = -1;
+                Gap = 0.f;
+                if (Collided)
+                    return;
+
+                // Only apart bounding boxes give a conservative distance; if they overlap while
+                // the pixels do not, the pair is tested again next time
+                sf::FloatRect A = Object1.getGlobalBounds();
+                sf::FloatRect B = Object2.getGlobalBounds();
+                float GapX = std::max(B.left-(A.left+A.width), A.left-(B.left+B.width));
+                float GapY = std::max(B.top-(A.top+A.height), A.top-(B.top+B.height));
+                if (GapX>Gap) { Axis = 0; Gap = GapX; }
+                if (GapY>Gap) { Axis = 1; Gap = GapY; }
+            }
+
+            // True while the relative motion along the separating axis is smaller than the gap
+            bool StillSeparated(const sf::Sprite& Object1, const sf::Sprite& Object2) const
+            {
+                if (Axis<0 || !Pose1.Matches(Object1) || !Pose2.Matches(Object2))
+                    return false;
+
+                sf::Vector2f Moved1 = Object1.getPosition()-Position1;
+                sf::Vector2f Moved2 = Object2.getPosition()-Position2;
+                float Closed = Axis==0 ? Moved1.x-Moved2.x : Moved1.y-Moved2.y;
+                return std::fabs(Closed)<Gap;
+            }
+        };
+
+        std::unordered_map<std::uint64_t, Entry> Entries;
+    };
+}
+
+#endif	/* COLLISION_H */
@@ -0,0 +1,109 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+// Console commands without blocking the caller. A reader thread collects the
+// lines typed on stdin and queues them; the simulation polls that queue once
+// per tick, so it can still be stopped and joined while a prompt is open.
+// On POSIX the reader waits with poll() and a short timeout and can be joined
+// too. Elsewhere it has to block in std::getline(); it is detached at exit
+// and only touches state it shares ownership of.
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <deque>
+#include <iostream>
+
+#if defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#   define CONSOLE_POSIX
+#   include <poll.h>
+#   include <unistd.h>
+#endif
+
+class ConsoleReader
+{
+    public:
+        ConsoleReader() : shared(std::make_shared<Shared>()) {}
+
+        ~ConsoleReader() { stop(); }
+
+        void start()
+        {
+            if (reader.joinable())
+                return;
+            shared->running = true;
+            reader = std::thread(&ConsoleReader::read, shared);
+        }
+
+        void stop()
+        {
+            shared->running = false;
+            if (!reader.joinable())
+                return;
+        #if defined(CONSOLE_POSIX)
+            reader.join();
+        #else
+            reader.detach();
+        #endif
+        }
+
+        /// Takes the oldest line typed so far; false if there is none
+        bool poll(std::string& line)
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            if (shared->lines.empty())
+                return false;
+            line = shared->lines.front();
+            shared->lines.pop_front();
+            return true;
+        }
+
+    private:
+        struct Shared
+        {
+            std::atomic<bool> running;
+            std::mutex mutex;
+            std::deque<std::string> lines;
+        };
+
+        static void read(std::shared_ptr<Shared> shared)
+        {
+        #if defined(CONSOLE_POSIX)
+            std::string pending;
+            char buffer[256];
+            while (shared->running)
+            {
+                pollfd waiting = { STDIN_FILENO, POLLIN, 0 };
+                if (::poll(&waiting, 1, 200) <= 0)
+                    continue;
+
+                ssize_t count = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+                if (count <= 0)
+                    break;
+
+                pending.append(buffer, count);
+                std::size_t end;
+                while ((end = pending.find('\n')) != std::string::npos)
+                {
+                    std::lock_guard<std::mutex> lock(shared->mutex);
+                    shared->lines.push_back(pending.substr(0, end));
+                    pending.erase(0, end + 1);
+                }
+            }
+        #else
+            std::string line;
+            while (shared->running && std::getline(std::cin, line))
+            {
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                shared->lines.push_back(line);
+            }
+        #endif
+        }
+
+        std::shared_ptr<Shared> shared;
+        std::thread reader;
+};
+
+#endif // CONSOLE_H
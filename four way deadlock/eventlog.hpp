@@ -0,0 +1,247 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+// Structured event log. The simulation pushes fixed size records into a
+// lock-free ring buffer and a background thread drains them into the sinks,
+// so the main loop never formats text or touches a stream itself.
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <ostream>
+#include <cstdio>
+#include <cstdint>
+
+#if defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#   include <unistd.h>
+#endif
+
+namespace EventLog
+{
+    enum EventType : std::uint32_t { Collision, Deadlock, Resolve, LightChange, Forecast, EventTypeCount };
+
+    enum LightColor { Red, Green };
+
+    /// Traffic lights are identified by the corner of the crossroad they stand on
+    enum LightCorner { NorthEast, SouthEast, NorthWest, SouthWest };
+
+    inline const char* typeName(std::uint32_t type)
+    {
+        static const char* names[EventTypeCount] = { "collision", "deadlock", "resolve", "light_change", "forecast" };
+        return type < EventTypeCount ? names[type] : "unknown";
+    }
+
+    /// One log record, written as is by the binary sink
+    struct Event
+    {
+        std::uint64_t tick;
+        std::uint32_t type;
+        std::int32_t a;      // first vehicle id, or the LightCorner for LightChange
+        std::int32_t b;      // second vehicle id, or the LightColor for LightChange
+        std::int32_t value;  // ticks until contact for Forecast
+    };
+
+    /// Single producer, single consumer queue; push never blocks and drops when full
+    template <std::size_t Capacity>
+    class RingBuffer
+    {
+        static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        RingBuffer() : head(0), tail(0) {}
+
+        bool push(const Event& event)
+        {
+            std::size_t write = head.load(std::memory_order_relaxed);
+            if (write - tail.load(std::memory_order_acquire) == Capacity)
+                return false;
+            slots[write & (Capacity - 1)] = event;
+            head.store(write + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(Event& event)
+        {
+            std::size_t read = tail.load(std::memory_order_relaxed);
+            if (read == head.load(std::memory_order_acquire))
+                return false;
+            event = slots[read & (Capacity - 1)];
+            tail.store(read + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool empty() const
+        {
+            return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+        }
+
+    private:
+        Event slots[Capacity];
+        alignas(64) std::atomic<std::size_t> head;
+        alignas(64) std::atomic<std::size_t> tail;
+    };
+
+    class Sink
+    {
+    public:
+        virtual ~Sink() {}
+        virtual void write(const Event& event) = 0;
+        virtual void flush() {}
+    };
+
+    class JsonLinesSink : public Sink
+    {
+    public:
+        explicit JsonLinesSink(std::ostream& stream) : stream(stream) {}
+
+        void write(const Event& event)
+        {
+            stream<<"{\"tick\":"<<event.tick<<",\"event\":\""<<typeName(event.type)<<"\"";
+            if (event.type == LightChange)
+                stream<<",\"corner\":"<<event.a<<",\"color\":\""<<(event.b == Green ? "green" : "red")<<"\"";
+            else if (event.type == Collision || event.type == Deadlock)
+                stream<<",\"a\":"<<event.a<<",\"b\":"<<event.b;
+            else if (event.type == Forecast)
+                stream<<",\"a\":"<<event.a<<",\"b\":"<<event.b<<",\"ticks_ahead\":"<<event.value;
+            stream<<"}\n";
+        }
+
+        void flush() { stream.flush(); }
+
+    private:
+        std::ostream& stream;
+    };
+
+    class BinarySink : public Sink
+    {
+    public:
+        explicit BinarySink(std::FILE* file) : file(file) {}
+
+        void write(const Event& event) { std::fwrite(&event, sizeof(Event), 1, file); }
+        void flush() { std::fflush(file); }
+
+    private:
+        std::FILE* file;
+    };
+
+    /// Human readable messages; whether to color is decided once, not per write
+    class ConsoleSink : public Sink
+    {
+    public:
+        ConsoleSink(std::ostream& stream, bool color) : stream(stream), color(color) {}
+
+        void write(const Event& event)
+        {
+            switch (event.type)
+            {
+            case Deadlock:
+                paint("\033[31m");
+                stream<<"There was a collison, Road Blocked!";
+                break;
+            case Resolve:
+                paint("\033[32m");
+                stream<<"Deadlock resolved, traffic lights on";
+                break;
+            case Forecast:
+                paint("\033[33m");
+                stream<<"Deadlock expected in "<<event.value<<" ticks";
+                break;
+            default:
+                return;
+            }
+            paint("\033[00m");
+            stream<<'\n';
+        }
+
+        void flush() { stream.flush(); }
+
+    private:
+        void paint(const char* code)
+        {
+            if (color)
+                stream<<code;
+        }
+
+        std::ostream& stream;
+        bool color;
+    };
+
+    inline bool stdoutIsTerminal()
+    {
+    #if defined(__unix__) || defined(__unix) || defined(__APPLE__)
+        return isatty(fileno(stdout)) != 0;
+    #else
+        return false;
+    #endif
+    }
+
+    class Logger
+    {
+    public:
+        /// The sinks are not owned and have to outlive the logger
+        explicit Logger(const std::vector<Sink*>& sinks)
+            : sinks(sinks), running(true), dropped(0), drainer(&Logger::drain, this) {}
+
+        ~Logger()
+        {
+            running = false;
+            drainer.join();
+        }
+
+        void log(std::uint64_t tick, EventType type, int a = -1, int b = -1, int value = 0)
+        {
+            Event event = { tick, type, a, b, value };
+            if (!buffer.push(event))
+                dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// Wait until everything logged so far reached the sinks, for use before prompting on the console
+        void flush()
+        {
+            while (!buffer.empty())
+                std::this_thread::yield();
+            flushRequested = true;
+            while (flushRequested)
+                std::this_thread::yield();
+        }
+
+        std::uint64_t droppedEvents() const { return dropped.load(std::memory_order_relaxed); }
+
+    private:
+        void drain()
+        {
+            Event event;
+            while (true)
+            {
+                bool wrote = false;
+                while (buffer.pop(event))
+                {
+                    for (Sink* sink : sinks)
+                        sink->write(event);
+                    wrote = true;
+                }
+
+                if (wrote || flushRequested)
+                {
+                    for (Sink* sink : sinks)
+                        sink->flush();
+                    flushRequested = false;
+                }
+                else if (!running)
+                    break;
+                else
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        }
+
+        RingBuffer<4096> buffer;
+        std::vector<Sink*> sinks;
+        std::atomic<bool> running;
+        std::atomic<bool> flushRequested{false};
+        std::atomic<std::uint64_t> dropped;
+        std::thread drainer;
+    };
+}
+
+#endif // EVENTLOG_H
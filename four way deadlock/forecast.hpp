@@ -0,0 +1,260 @@
+#ifndef FORECAST_H
+#define FORECAST_H
+
+// Deadlock forecasting ahead of contact. Every vehicle is projected along its
+// current velocity; the spatial grid over the swept boxes yields candidate
+// pairs, which get an exact time of first contact. A vehicle that would run
+// into another one lying ahead of it is blocked by it, and a cycle in that
+// "blocked by" graph is a deadlock that has not happened yet. Vehicles that
+// will halt at a red stop line only move until then, so they cannot meet the
+// crossing traffic behind it.
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "spatialgrid.hpp"
+
+namespace Forecast
+{
+    struct Mover
+    {
+        int id;
+        float x, y, width, height;  // box now
+        float vx, vy;               // per tick
+        float stop;                 // ticks until it halts at a stop line, anything past the horizon if it does not
+    };
+
+    /// Transparent border around the car images; opposite lanes overlap by a few pixels without it
+    const float ImageBorder = 6.f;
+
+    /// Mover for the body of a car, given the box of its image
+    inline Mover bodyOf(int id, float x, float y, float width, float height, float vx, float vy, float border = ImageBorder)
+    {
+        Mover mover = { id, x + border, y + border, width - 2.f * border, height - 2.f * border, vx, vy, 1e9f };
+        return mover;
+    }
+
+    struct Conflict
+    {
+        int blocked;   // index into the movers, the vehicle that runs into the other
+        int blocker;
+        float time;    // ticks until contact
+    };
+
+    struct Cycle
+    {
+        std::vector<int> movers;   // indices into the movers
+        float time;                // ticks until the last contact closing the cycle
+    };
+
+    /// Time of first contact of two boxes moving at constant velocities, or -1 if not within the horizon
+    inline float contactTime(const Mover& a, const Mover& b, float horizon)
+    {
+        float enter = 0.f, leave = horizon;
+        float gaps[2][2] = {
+            { b.x - (a.x + a.width), (b.x + b.width) - a.x },
+            { b.y - (a.y + a.height), (b.y + b.height) - a.y }
+        };
+        float relative[2] = { a.vx - b.vx, a.vy - b.vy };
+
+        for (int axis = 0; axis < 2; axis++)
+        {
+            float low = gaps[axis][0], high = gaps[axis][1];
+            if (std::fabs(relative[axis]) < 1e-6f)
+            {
+                if (low >= 0.f || high <= 0.f)
+                    return -1.f;
+                continue;
+            }
+            float first = low / relative[axis], second = high / relative[axis];
+            if (first > second)
+                std::swap(first, second);
+            enter = std::max(enter, first);
+            leave = std::min(leave, second);
+            if (enter > leave)
+                return -1.f;
+        }
+        return enter;
+    }
+
+    class Forecaster
+    {
+    public:
+        explicit Forecaster(float horizon) : horizon(horizon), grid(128.f) {}
+
+        void setHorizon(float ticks) { horizon = ticks; }
+        float getHorizon() const { return horizon; }
+
+        /// Returns the predicted deadlock cycles, soonest first
+        const std::vector<Cycle>& run(const std::vector<Mover>& movers)
+        {
+            conflicts.clear();
+            cycles.clear();
+
+            // Broad phase over the boxes swept during the horizon
+            grid.clear();
+            for (std::size_t index = 0; index < movers.size(); index++)
+                grid.insert(int(index), swept(movers[index]));
+
+            for (std::size_t index = 0; index < movers.size(); index++)
+            {
+                grid.query(swept(movers[index]), candidates);
+                for (int other : candidates)
+                {
+                    if (other <= int(index))
+                        continue;
+                    float until = std::min(horizon, std::min(movers[index].stop, movers[other].stop));
+                    float time = contactTime(movers[index], movers[other], until);
+                    if (time < 0.f)
+                        continue;
+                    addBlocking(movers, int(index), other, time);
+                    addBlocking(movers, other, int(index), time);
+                }
+            }
+
+            findCycles(movers.size());
+            std::sort(cycles.begin(), cycles.end(), [](const Cycle& a, const Cycle& b) { return a.time < b.time; });
+            return cycles;
+        }
+
+        const std::vector<Conflict>& getConflicts() const { return conflicts; }
+
+    private:
+        Spatial::Box swept(const Mover& mover) const
+        {
+            float endX = mover.x + mover.vx * horizon, endY = mover.y + mover.vy * horizon;
+            Spatial::Box box = { std::min(mover.x, endX), std::min(mover.y, endY),
+                                 std::fabs(endX - mover.x) + mover.width, std::fabs(endY - mover.y) + mover.height };
+            return box;
+        }
+
+        /// At contact, the first mover is blocked if the second one lies ahead of it
+        void addBlocking(const std::vector<Mover>& movers, int first, int second, float time)
+        {
+            const Mover& a = movers[first];
+            const Mover& b = movers[second];
+            float aheadX = (b.x + b.vx * time + b.width / 2) - (a.x + a.vx * time + a.width / 2);
+            float aheadY = (b.y + b.vy * time + b.height / 2) - (a.y + a.vy * time + a.height / 2);
+            if (aheadX * a.vx + aheadY * a.vy > 0.f)
+                conflicts.push_back(Conflict{ first, second, time });
+        }
+
+        /// Tarjan's strongly connected components; every component with more than one mover is a cycle
+        void findCycles(std::size_t count)
+        {
+            edgeStart.assign(count + 1, 0);
+            for (const Conflict& conflict : conflicts)
+                edgeStart[conflict.blocked + 1]++;
+            for (std::size_t index = 0; index < count; index++)
+                edgeStart[index + 1] += edgeStart[index];
+            edges.assign(conflicts.size(), 0);
+            std::vector<int> fill(edgeStart.begin(), edgeStart.end() - 1);
+            for (std::size_t index = 0; index < conflicts.size(); index++)
+                edges[fill[conflicts[index].blocked]++] = int(index);
+
+            order.assign(count, -1);
+            lowLink.assign(count, 0);
+            onStack.assign(count, false);
+            inCycle.assign(count, false);
+            stack.clear();
+            counter = 0;
+            for (std::size_t index = 0; index < count; index++)
+            {
+                if (order[index] < 0 && edgeStart[index] != edgeStart[index + 1])
+                    connect(int(index));
+            }
+        }
+
+        /// Iterative, queues of thousands of cars would be too deep for recursion
+        void connect(int root)
+        {
+            calls.clear();
+            calls.push_back(Call{ root, edgeStart[root] });
+            order[root] = lowLink[root] = counter++;
+            stack.push_back(root);
+            onStack[root] = true;
+
+            while (!calls.empty())
+            {
+                Call& call = calls.back();
+                int node = call.node;
+                if (call.edge < edgeStart[node + 1])
+                {
+                    int next = conflicts[edges[call.edge++]].blocker;
+                    if (order[next] < 0)
+                    {
+                        order[next] = lowLink[next] = counter++;
+                        stack.push_back(next);
+                        onStack[next] = true;
+                        calls.push_back(Call{ next, edgeStart[next] });
+                    }
+                    else if (onStack[next])
+                        lowLink[node] = std::min(lowLink[node], order[next]);
+                    continue;
+                }
+
+                calls.pop_back();
+                if (!calls.empty())
+                    lowLink[calls.back().node] = std::min(lowLink[calls.back().node], lowLink[node]);
+                if (lowLink[node] == order[node])
+                    popComponent(node);
+            }
+        }
+
+        void popComponent(int node)
+        {
+            Cycle cycle;
+            int member;
+            do
+            {
+                member = stack.back();
+                stack.pop_back();
+                onStack[member] = false;
+                cycle.movers.push_back(member);
+            }
+            while (member != node);
+
+            if (cycle.movers.size() < 2)
+                return;
+
+            for (int mover : cycle.movers)
+                inCycle[mover] = true;
+
+            cycle.time = 0.f;
+            for (int mover : cycle.movers)
+            {
+                for (int edge = edgeStart[mover]; edge < edgeStart[mover + 1]; edge++)
+                {
+                    const Conflict& conflict = conflicts[edges[edge]];
+                    if (inCycle[conflict.blocker])
+                        cycle.time = std::max(cycle.time, conflict.time);
+                }
+            }
+
+            for (int mover : cycle.movers)
+                inCycle[mover] = false;
+            cycles.push_back(cycle);
+        }
+
+        float horizon;
+        Spatial::Grid grid;
+        std::vector<int> candidates;
+        std::vector<Conflict> conflicts;
+        std::vector<Cycle> cycles;
+
+        // Tarjan state
+        struct Call
+        {
+            int node;
+            int edge;
+        };
+
+        std::vector<int> edgeStart, edges, order, lowLink, stack;
+        std::vector<bool> onStack, inCycle;
+        std::vector<Call> calls;
+        int counter;
+    };
+}
+
+#endif // FORECAST_H
@@ -0,0 +1,167 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+// Frame pacing against the wall clock. Most of the wait is a real sleep so
+// the core stays idle; only the last stretch before the deadline is spun,
+// and that stretch follows how late the scheduler has been waking us up.
+// CPU time is sampled on the thread that calls wait(), so two pacers on two
+// threads each report their own share.
+
+#include <chrono>
+#include <thread>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <ostream>
+
+#if defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#   define FRAMEPACER_THREAD_CPU
+#   include <time.h>
+#endif
+
+class FramePacer
+{
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        explicit FramePacer(double framesPerSecond)
+            : period(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond))),
+              margin(std::chrono::microseconds(1000))
+        {
+            resetStats();
+            deadline = Clock::now() + period;
+        }
+
+        /// Block until the next frame is due, call once per frame after window.display()
+        void wait()
+        {
+            Clock::time_point wake = deadline - margin;
+            if (Clock::now() < wake)
+            {
+                std::this_thread::sleep_until(wake);
+                adaptMargin(Clock::now() - wake);
+            }
+            while (Clock::now() < deadline)
+            {
+            }
+
+            Clock::time_point now = Clock::now();
+            record(now);
+
+            // Fell more than a frame behind, start over instead of rushing to catch up
+            deadline += period;
+            if (deadline < now)
+                deadline = now + period;
+        }
+
+        void resetStats()
+        {
+            frames = 0;
+            meanInterval = 0;
+            squaredDeviation = 0;
+            worstInterval = 0;
+            lastFrame = Clock::now();
+            startWall = lastFrame;
+            lastWall = lastFrame;
+            startCpu = -1;
+            lastCpu = 0;
+        }
+
+        /// Mean frame interval in milliseconds
+        double getMeanInterval() const { return meanInterval * 1000.0; }
+
+        /// Standard deviation of the frame interval in milliseconds
+        double getJitter() const
+        {
+            return frames > 1 ? std::sqrt(squaredDeviation / (frames - 1)) * 1000.0 : 0.0;
+        }
+
+        double getWorstInterval() const { return worstInterval * 1000.0; }
+
+        /// Share of one core the pacing thread used between the first and the last wait() since resetStats()
+        double getCpuUtilisation() const
+        {
+            double wall = std::chrono::duration<double>(lastWall - startWall).count();
+            return wall > 0 && startCpu >= 0 ? (lastCpu - startCpu) / wall : 0.0;
+        }
+
+        double getSpinMargin() const
+        {
+            return std::chrono::duration<double, std::milli>(margin).count();
+        }
+
+        void report(std::ostream& stream) const
+        {
+            stream<<"Frames: "<<frames<<", interval "<<getMeanInterval()<<" ms, jitter "<<getJitter()
+                  <<" ms, worst "<<getWorstInterval()<<" ms, "<<CpuScope<<" CPU "<<getCpuUtilisation() * 100.0
+                  <<" %, spin margin "<<getSpinMargin()<<" ms"<<std::endl;
+        }
+
+    private:
+    #if defined(FRAMEPACER_THREAD_CPU)
+        static constexpr const char* CpuScope = "thread";
+
+        static double cpuNow()
+        {
+            timespec time;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+            return time.tv_sec + time.tv_nsec / 1e9;
+        }
+    #else
+        static constexpr const char* CpuScope = "process";
+
+        static double cpuNow() { return double(std::clock()) / CLOCKS_PER_SEC; }
+    #endif
+
+        /// Keep the spin margin a little above the typical oversleep of sleep_until()
+        void adaptMargin(Clock::duration oversleep)
+        {
+            double late = std::chrono::duration<double>(oversleep).count();
+            lateness = lateness * 0.9 + late * 0.1;
+            latenessSpread = latenessSpread * 0.9 + std::fabs(late - lateness) * 0.1;
+
+            double seconds = std::min(std::max(lateness + 3.0 * latenessSpread, 0.0001), 0.004);
+            margin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        }
+
+        void record(Clock::time_point now)
+        {
+            double interval = std::chrono::duration<double>(now - lastFrame).count();
+            lastFrame = now;
+
+            // The pacer may be built on another thread, so CPU time starts at the first wait()
+            lastCpu = cpuNow();
+            lastWall = now;
+            if (startCpu < 0)
+            {
+                startCpu = lastCpu;
+                startWall = now;
+            }
+
+            // Welford's running mean and variance
+            frames++;
+            double delta = interval - meanInterval;
+            meanInterval += delta / frames;
+            squaredDeviation += delta * (interval - meanInterval);
+            worstInterval = std::max(worstInterval, interval);
+        }
+
+        Clock::duration period;
+        Clock::duration margin;
+        Clock::time_point deadline;
+        Clock::time_point lastFrame;
+        Clock::time_point startWall;
+        Clock::time_point lastWall;
+        double startCpu;
+        double lastCpu;
+
+        double lateness = 0.0005;
+        double latenessSpread = 0.0002;
+
+        long frames;
+        double meanInterval;
+        double squaredDeviation;
+        double worstInterval;
+};
+
+#endif // FRAMEPACER_H
@@ -3,805 +3,186 @@
 #include <map>
 #include <algorithm>
 #include <iomanip>
-#include <time.h>
 #include <cmath>
+#include <fstream>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <sstream>
+
+#include "assets.hpp"
+#include "collision.hpp"
+#include "eventlog.hpp"
+#include "framepacer.hpp"
+#include "metrics.hpp"
+#include "camera.hpp"
+#include "spatialgrid.hpp"
+#include "forecast.hpp"
+#include "roadmodel.hpp"
+#include "triplebuffer.hpp"
+#include "console.hpp"
 
 using namespace sf;
 
-//!
-//! termcolor
-//! ~~~~~~~~~
-//!
-//! termcolor is a header-only c++ library for printing colored messages
-//! to the terminal. Written just for fun with a help of the Force.
-//!
-//! :copyright: (c) 2013 by Ihor Kalnytskyi
-//! :license: BSD, see LICENSE for details
-//!
-
-#ifndef TERMCOLOR_HPP_
-#define TERMCOLOR_HPP_
-
-// the following snippet of code detects the current OS and
-// defines the appropriate macro that is used to wrap some
-// platform specific things
-#if defined(_WIN32) || defined(_WIN64)
-#   define TERMCOLOR_OS_WINDOWS
-#elif defined(__APPLE__)
-#   define TERMCOLOR_OS_MACOS
-#elif defined(__unix__) || defined(__unix)
-#   define TERMCOLOR_OS_LINUX
-#else
-#   error unsupported platform
-#endif
-
-
-// This headers provides the `isatty()`/`fileno()` functions,
-// which are used for testing whether a standart stream refers
-// to the terminal. As for Windows, we also need WinApi funcs
-// for changing colors attributes of the terminal.
-#if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-#   include <unistd.h>
-#elif defined(TERMCOLOR_OS_WINDOWS)
-#   include <io.h>
-#   include <windows.h>
-#endif
+/// Textures decoded at startup, owned by main()
+const AssetLoader* preloaded = 0;
 
-
-#include <iostream>
-#include <cstdio>
-
-
-
-namespace termcolor
+class GameObject
 {
-    // Forward declaration of the `_internal` namespace.
-    // All comments are below.
-    namespace _internal
-    {
-        // An index to be used to access a private storage of I/O streams. See
-        // colorize / nocolorize I/O manipulators for details.
-        static int colorize_index = std::ios_base::xalloc();
-
-        inline FILE* get_standard_stream(const std::ostream& stream);
-        inline bool is_colorized(std::ostream& stream);
-        inline bool is_atty(const std::ostream& stream);
-
-    #if defined(TERMCOLOR_OS_WINDOWS)
-        inline void win_change_attributes(std::ostream& stream, int foreground, int background=-1);
-    #endif
-    }
-
-    inline
-    std::ostream& colorize(std::ostream& stream)
-    {
-        stream.iword(_internal::colorize_index) = 1L;
-        return stream;
-    }
-
-    inline
-    std::ostream& nocolorize(std::ostream& stream)
-    {
-        stream.iword(_internal::colorize_index) = 0L;
-        return stream;
-    }
-
-    inline
-    std::ostream& reset(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[00m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream, -1, -1);
-        #endif
-        }
-        return stream;
-    }
-
-
-    inline
-    std::ostream& bold(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[1m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-        #endif
-        }
-        return stream;
-    }
-
-
-    inline
-    std::ostream& dark(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[2m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-        #endif
-        }
-        return stream;
-    }
-
-
-    inline
-    std::ostream& underline(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[4m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-        #endif
-        }
-        return stream;
-    }
-
-
-    inline
-    std::ostream& blink(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[5m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-        #endif
-        }
-        return stream;
-    }
-
-
-    inline
-    std::ostream& reverse(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[7m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-        #endif
-        }
-        return stream;
-    }
-
-
-    inline
-    std::ostream& concealed(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[8m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-        #endif
-        }
-        return stream;
-    }
-
-
-    inline
-    std::ostream& grey(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[30m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream,
-                0   // grey (black)
-            );
-        #endif
-        }
-        return stream;
-    }
-
-    inline
-    std::ostream& red(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[31m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream,
-                FOREGROUND_RED
-            );
-        #endif
-        }
-        return stream;
-    }
-
-    inline
-    std::ostream& green(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[32m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream,
-                FOREGROUND_GREEN
-            );
-        #endif
-        }
-        return stream;
-    }
-
-    inline
-    std::ostream& yellow(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[33m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream,
-                FOREGROUND_GREEN | FOREGROUND_RED
-            );
-        #endif
-        }
-        return stream;
-    }
-
-    inline
-    std::ostream& blue(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[34m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream,
-                FOREGROUND_BLUE
-            );
-        #endif
-        }
-        return stream;
-    }
-
-    inline
-    std::ostream& magenta(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[35m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream,
-                FOREGROUND_BLUE | FOREGROUND_RED
-            );
-        #endif
-        }
-        return stream;
-    }
-
-    inline
-    std::ostream& cyan(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[36m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream,
-                FOREGROUND_BLUE | FOREGROUND_GREEN
-            );
-        #endif
-        }
-        return stream;
-    }
-
-    inline
-    std::ostream& white(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[37m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream,
-                FOREGROUND_BLUE | FOREGROUND_GREEN | FOREGROUND_RED
-            );
-        #endif
-        }
-        return stream;
-    }
-
-
-
-    inline
-    std::ostream& on_grey(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
-        {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[40m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream, -1,
-                0   // grey (black)
-            );
-        #endif
-        }
-        return stream;
-    }
+    public:
+        /// Cars need the full collision cascade down to the pixels
+        typedef Collision::PixelShape Shape;
 
-    inline
-    std::ostream& on_red(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
+        void loadTexture(std::string textureName, float vecX, float vecY)
         {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[41m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream, -1,
-                BACKGROUND_RED
-            );
-        #endif
+            const Texture* shared = preloaded ? preloaded->getTexture(textureName) : 0;
+            if (shared)
+            {
+                sprite.setTexture(*shared, true);
+                mask = preloaded->getMask(textureName);
+            }
+            else
+            {
+                // Reloads in place, the bitmask manager gets the new mask and drops the old one
+                if (!Collision::CreateTextureAndBitmask(texture, textureName))
+                {
+                    std::cout<<"Error occoured!, failed to load "<<textureName<<std::endl;
+                }
+                sprite.setTexture(texture, true);
+                mask = Collision::MaskId();
+            }
+            sprite.setRotation(0);
+            sprite.setOrigin(0, 0);
+            sprite.setPosition(Vector2f(vecX,vecY));
+            version++;
         }
-        return stream;
-    }
 
-    inline
-    std::ostream& on_green(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
+        void moveSprite(float X, float Y)
         {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[42m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream, -1,
-                BACKGROUND_GREEN
-            );
-        #endif
+            sprite.move(X,Y);
+            version++;
         }
-        return stream;
-    }
 
-    inline
-    std::ostream& on_yellow(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
+        /// Turns around the center of the sprite instead of its corner
+        void rotateSprite(float degrees)
         {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[43m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream, -1,
-                BACKGROUND_GREEN | BACKGROUND_RED
-            );
-        #endif
+            if (sprite.getOrigin() == Vector2f())
+            {
+                FloatRect local = sprite.getLocalBounds();
+                sprite.setOrigin(local.width / 2, local.height / 2);
+                sprite.move(local.width / 2, local.height / 2);
+            }
+            sprite.rotate(degrees);
+            version++;
         }
-        return stream;
-    }
 
-    inline
-    std::ostream& on_blue(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
+        float getRotation() const
         {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[44m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream, -1,
-                BACKGROUND_BLUE
-            );
-        #endif
+            return sprite.getRotation();
         }
-        return stream;
-    }
 
-    inline
-    std::ostream& on_magenta(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
+        Sprite getSprite()
         {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[45m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream, -1,
-                BACKGROUND_BLUE | BACKGROUND_RED
-            );
-        #endif
+            return sprite;
         }
-        return stream;
-    }
 
-    inline
-    std::ostream& on_cyan(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
+        /// Road::movement() the car follows through the crossroad
+        void setMovement(int route)
         {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[46m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream, -1,
-                BACKGROUND_GREEN | BACKGROUND_BLUE
-            );
-        #endif
+            movement = route;
         }
-        return stream;
-    }
 
-    inline
-    std::ostream& on_white(std::ostream& stream)
-    {
-        if (_internal::is_colorized(stream))
+        int getMovement() const
         {
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            stream << "\033[47m";
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            _internal::win_change_attributes(stream, -1,
-                BACKGROUND_GREEN | BACKGROUND_BLUE | BACKGROUND_RED
-            );
-        #endif
+            return movement;
         }
 
-        return stream;
-    }
-
-
-
-    //! Since C++ hasn't a way to hide something in the header from
-    //! the outer access, I have to introduce this namespace which
-    //! is used for internal purpose and should't be access from
-    //! the user code.
-    namespace _internal
-    {
-        //! Since C++ hasn't a true way to extract stream handler
-        //! from the a given `std::ostream` object, I have to write
-        //! this kind of hack.
-        inline
-        FILE* get_standard_stream(const std::ostream& stream)
+        /// Goes up whenever the sprite changes, snapshots compare it to skip unchanged objects
+        unsigned long getVersion() const
         {
-            if (&stream == &std::cout)
-                return stdout;
-            else if ((&stream == &std::cerr) || (&stream == &std::clog))
-                return stderr;
-
-            return 0;
+            return version;
         }
 
-        // Say whether a given stream should be colorized or not. It's always
-        // true for ATTY streams and may be true for streams marked with
-        // colorize flag.
-        inline
-        bool is_colorized(std::ostream& stream)
+        Collision::MaskId getMask() const
         {
-            return is_atty(stream) || static_cast<bool>(stream.iword(colorize_index));
+            return mask;
         }
 
-        //! Test whether a given `std::ostream` object refers to
-        //! a terminal.
-        inline
-        bool is_atty(const std::ostream& stream)
+        Spatial::Box getBounds() const
         {
-            FILE* std_stream = get_standard_stream(stream);
-
-            // Unfortunately, fileno() ends with segmentation fault
-            // if invalid file descriptor is passed. So we need to
-            // handle this case gracefully and assume it's not a tty
-            // if standard stream is not detected, and 0 is returned.
-            if (!std_stream)
-                return false;
-
-        #if defined(TERMCOLOR_OS_MACOS) || defined(TERMCOLOR_OS_LINUX)
-            return ::isatty(fileno(std_stream));
-        #elif defined(TERMCOLOR_OS_WINDOWS)
-            return ::_isatty(_fileno(std_stream));
-        #endif
+            FloatRect bounds = sprite.getGlobalBounds();
+            Spatial::Box box = { bounds.left, bounds.top, bounds.width, bounds.height };
+            return box;
         }
 
-    #if defined(TERMCOLOR_OS_WINDOWS)
-        //! Change Windows Terminal colors attribute. If some
-        //! parameter is `-1` then attribute won't changed.
-        inline void win_change_attributes(std::ostream& stream, int foreground, int background)
+        ~GameObject()
         {
-            // yeah, i know.. it's ugly, it's windows.
-            static WORD defaultAttributes = 0;
-
-            // Windows doesn't have ANSI escape sequences and so we use special
-            // API to change Terminal output color. That means we can't
-            // manipulate colors by means of "std::stringstream" and hence
-            // should do nothing in this case.
-            if (!_internal::is_atty(stream))
-                return;
-
-            // get terminal handle
-            HANDLE hTerminal = INVALID_HANDLE_VALUE;
-            if (&stream == &std::cout)
-                hTerminal = GetStdHandle(STD_OUTPUT_HANDLE);
-            else if (&stream == &std::cerr)
-                hTerminal = GetStdHandle(STD_ERROR_HANDLE);
-
-            // save default terminal attributes if it unsaved
-            if (!defaultAttributes)
-            {
-                CONSOLE_SCREEN_BUFFER_INFO info;
-                if (!GetConsoleScreenBufferInfo(hTerminal, &info))
-                    return;
-                defaultAttributes = info.wAttributes;
-            }
-
-            // restore all default settings
-            if (foreground == -1 && background == -1)
-            {
-                SetConsoleTextAttribute(hTerminal, defaultAttributes);
-                return;
-            }
-
-            // get current settings
-            CONSOLE_SCREEN_BUFFER_INFO info;
-            if (!GetConsoleScreenBufferInfo(hTerminal, &info))
-                return;
-
-            if (foreground != -1)
-            {
-                info.wAttributes &= ~(info.wAttributes & 0x0F);
-                info.wAttributes |= static_cast<WORD>(foreground);
-            }
-
-            if (background != -1)
-            {
-                info.wAttributes &= ~(info.wAttributes & 0xF0);
-                info.wAttributes |= static_cast<WORD>(background);
-            }
-
-            SetConsoleTextAttribute(hTerminal, info.wAttributes);
+            Collision::Bitmasks.Release(&texture);
         }
-    #endif // TERMCOLOR_OS_WINDOWS
-
-    } // namespace _internal
-
-} // namespace termcolor
 
+    private:
+        Texture texture;
+        Collision::MaskId mask;
+        float directionX;
+        float directionY;
+        Sprite sprite;
+        unsigned long version = 1;
+        int movement = Road::movement(Road::FromWest, Road::Straight);
+};
 
-#undef TERMCOLOR_OS_WINDOWS
-#undef TERMCOLOR_OS_MACOS
-#undef TERMCOLOR_OS_LINUX
-
-#endif // TERMCOLOR_HPP_
-
-#ifndef COLLISION_H
-#define COLLISION_H
-
-namespace Collision {
-
-    bool PixelPerfectTest(const sf::Sprite& Object1 ,const sf::Sprite& Object2, sf::Uint8 AlphaLimit = 0);
+/// One tick of the simulation as the render thread sees it. Each slot keeps its sprites and
+/// draw grid between publishes; ids 0-3 are the lights and 4-13 the cars
+struct Snapshot
+{
+    Sprite cars[10];
+    Sprite lights[4];
+    bool lightsOn = false;
+    unsigned long tick = 0;
+    Spatial::Grid drawGrid = Spatial::Grid(128);
+    unsigned long versions[14] = {};
+};
 
-    bool CreateTextureAndBitmask(sf::Texture &LoadInto, const std::string& Filename);
+typedef std::chrono::steady_clock SteadyClock;
 
-    bool CircleTest(const sf::Sprite& Object1, const sf::Sprite& Object2);
+Collision::CoherenceCache collisionCache;
+Metrics::Counter collisionTests;
+Metrics::Histogram collisionTestTime(Metrics::secondsBuckets());
 
-    bool BoundingBoxTest(const sf::Sprite& Object1, const sf::Sprite& Object2);
+double secondsSince(SteadyClock::time_point start)
+{
+    return std::chrono::duration<double>(SteadyClock::now() - start).count();
 }
 
-#endif	/* COLLISION_H */
-
-namespace Collision
+bool collision(GameObject object[10], int first, int second)
 {
-    class BitmaskManager
-    {
-    public:
-        ~BitmaskManager() {
-            std::map<const sf::Texture*, sf::Uint8*>::const_iterator end = Bitmasks.end();
-            for (std::map<const sf::Texture*, sf::Uint8*>::const_iterator iter = Bitmasks.begin(); iter!=end; iter++)
-                delete [] iter->second;
-        }
-
-        sf::Uint8 GetPixel (const sf::Uint8* mask, const sf::Texture* tex, unsigned int x, unsigned int y) {
-            if (x>tex->getSize().x||y>tex->getSize().y)
-                return 0;
-
-            return mask[x+y*tex->getSize().x];
-        }
-
-        sf::Uint8* GetMask (const sf::Texture* tex) {
-            sf::Uint8* mask;
-            std::map<const sf::Texture*, sf::Uint8*>::iterator pair = Bitmasks.find(tex);
-            if (pair==Bitmasks.end())
-            {
-                sf::Image img = tex->copyToImage();
-                mask = CreateMask (tex, img);
-            }
-            else
-                mask = pair->second;
-
-            return mask;
-        }
-
-        sf::Uint8* CreateMask (const sf::Texture* tex, const sf::Image& img) {
-            sf::Uint8* mask = new sf::Uint8[tex->getSize().y*tex->getSize().x];
-
-            for (unsigned int y = 0; y<tex->getSize().y; y++)
-            {
-                for (unsigned int x = 0; x<tex->getSize().x; x++)
-                    mask[x+y*tex->getSize().x] = img.getPixel(x,y).a;
-            }
-
-            Bitmasks.insert(std::pair<const sf::Texture*, sf::Uint8*>(tex,mask));
-
-            return mask;
-        }
-    private:
-        std::map<const sf::Texture*, sf::Uint8*> Bitmasks;
-    };
-
-    BitmaskManager Bitmasks;
-
-    bool PixelPerfectTest(const sf::Sprite& Object1, const sf::Sprite& Object2, sf::Uint8 AlphaLimit) {
-        sf::FloatRect Intersection;
-        if (Object1.getGlobalBounds().intersects(Object2.getGlobalBounds(), Intersection)) {
-            sf::IntRect O1SubRect = Object1.getTextureRect();
-            sf::IntRect O2SubRect = Object2.getTextureRect();
-
-            sf::Uint8* mask1 = Bitmasks.GetMask(Object1.getTexture());
-            sf::Uint8* mask2 = Bitmasks.GetMask(Object2.getTexture());
-
-            // Loop through our pixels
-            for (int i = Intersection.left; i < Intersection.left+Intersection.width; i++) {
-                for (int j = Intersection.top; j < Intersection.top+Intersection.height; j++) {
-
-                    sf::Vector2f o1v = Object1.getInverseTransform().transformPoint(i, j);
-                    sf::Vector2f o2v = Object2.getInverseTransform().transformPoint(i, j);
-
-                    // Make sure pixels fall within the sprite's subrect
-                    if (o1v.x > 0 && o1v.y > 0 && o2v.x > 0 && o2v.y > 0 &&
-                        o1v.x < O1SubRect.width && o1v.y < O1SubRect.height &&
-                        o2v.x < O2SubRect.width && o2v.y < O2SubRect.height) {
-
-                        if (Bitmasks.GetPixel(mask1, Object1.getTexture(), (int)(o1v.x)+O1SubRect.left, (int)(o1v.y)+O1SubRect.top) > AlphaLimit &&
-                            Bitmasks.GetPixel(mask2, Object2.getTexture(), (int)(o2v.x)+O2SubRect.left, (int)(o2v.y)+O2SubRect.top) > AlphaLimit)
-                            return true;
-
-                    }
-                }
-            }
-        }
-        return false;
-    }
-
-    bool CreateTextureAndBitmask(sf::Texture &LoadInto, const std::string& Filename)
-    {
-        sf::Image img;
-        if (!img.loadFromFile(Filename))
-            return false;
-        if (!LoadInto.loadFromImage(img))
-            return false;
-
-        Bitmasks.CreateMask(&LoadInto, img);
-        return true;
-    }
+    SteadyClock::time_point start = SteadyClock::now();
+    bool collided = collisionCache.Test<GameObject::Shape, GameObject::Shape>(first,object[first].getSprite(),second,object[second].getSprite(),
+                                                                             0,object[first].getMask(),object[second].getMask());
+    collisionTests.add();
+    collisionTestTime.observe(secondsSince(start));
+    return collided;
+}
 
-    sf::Vector2f GetSpriteCenter (const sf::Sprite& Object)
+/// Right turn from the eastbound lane into the southbound one, along a quarter circle
+void turnRight(GameObject& car, float speed)
+{
+    const float turnAt = 340, radius = 24;
+    Spatial::Box box = car.getBounds();
+    float rotation = car.getRotation();
+    if(rotation == 0 && box.left + box.width / 2 < turnAt)
     {
-        sf::FloatRect AABB = Object.getGlobalBounds();
-        return sf::Vector2f (AABB.left+AABB.width/2.f, AABB.top+AABB.height/2.f);
+        car.moveSprite(speed, 0);
+        return;
     }
-
-    sf::Vector2f GetSpriteSize (const sf::Sprite& Object)
+    if(rotation < 90)
     {
-        sf::IntRect OriginalSize = Object.getTextureRect();
-        sf::Vector2f Scale = Object.getScale();
-        return sf::Vector2f (OriginalSize.width*Scale.x, OriginalSize.height*Scale.y);
+        float step = std::min(speed / radius * 180 / 3.14159265f, 90 - rotation);
+        float heading = (rotation + step / 2) * 3.14159265f / 180;
+        car.rotateSprite(step);
+        car.moveSprite(speed * std::cos(heading), speed * std::sin(heading));
+        return;
     }
-
-    bool CircleTest(const sf::Sprite& Object1, const sf::Sprite& Object2) {
-        sf::Vector2f Obj1Size = GetSpriteSize(Object1);
-        sf::Vector2f Obj2Size = GetSpriteSize(Object2);
-        float Radius1 = (Obj1Size.x + Obj1Size.y) / 4;
-        float Radius2 = (Obj2Size.x + Obj2Size.y) / 4;
-
-        sf::Vector2f Distance = GetSpriteCenter(Object1)-GetSpriteCenter(Object2);
-
-        return (Distance.x * Distance.x + Distance.y * Distance.y <= (Radius1 + Radius2) * (Radius1 + Radius2));
-    }
-
-    class OrientedBoundingBox // Used in the BoundingBoxTest
-    {
-    public:
-        OrientedBoundingBox (const sf::Sprite& Object) // Calculate the four points of the OBB from a transformed (scaled, rotated...) sprite
-        {
-            sf::Transform trans = Object.getTransform();
-            sf::IntRect local = Object.getTextureRect();
-            Points[0] = trans.transformPoint(0.f, 0.f);
-            Points[1] = trans.transformPoint(local.width, 0.f);
-            Points[2] = trans.transformPoint(local.width, local.height);
-            Points[3] = trans.transformPoint(0.f, local.height);
-        }
-
-        sf::Vector2f Points[4];
-
-        void ProjectOntoAxis (const sf::Vector2f& Axis, float& Min, float& Max) // Project all four points of the OBB onto the given axis and return the dotproducts of the two outermost points
-        {
-            Min = (Points[0].x*Axis.x+Points[0].y*Axis.y);
-            Max = Min;
-            for (int j = 1; j<4; j++)
-            {
-                float Projection = (Points[j].x*Axis.x+Points[j].y*Axis.y);
-
-                if (Projection<Min)
-                    Min=Projection;
-                if (Projection>Max)
-                    Max=Projection;
-            }
-        }
-    };
-
-    bool BoundingBoxTest(const sf::Sprite& Object1, const sf::Sprite& Object2) {
-        OrientedBoundingBox OBB1 (Object1);
-        OrientedBoundingBox OBB2 (Object2);
-
-        // Create the four distinct axes that are perpendicular to the edges of the two rectangles
-        sf::Vector2f Axes[4] = {
-            sf::Vector2f (OBB1.Points[1].x-OBB1.Points[0].x,
-                          OBB1.Points[1].y-OBB1.Points[0].y),
-            sf::Vector2f (OBB1.Points[1].x-OBB1.Points[2].x,
-                          OBB1.Points[1].y-OBB1.Points[2].y),
-            sf::Vector2f (OBB2.Points[0].x-OBB2.Points[3].x,
-                          OBB2.Points[0].y-OBB2.Points[3].y),
-            sf::Vector2f (OBB2.Points[0].x-OBB2.Points[1].x,
-                          OBB2.Points[0].y-OBB2.Points[1].y)
-        };
-
-        for (int i = 0; i<4; i++) // For each axis...
-        {
-            float MinOBB1, MaxOBB1, MinOBB2, MaxOBB2;
-
-            // ... project the points of both OBBs onto the axis ...
-            OBB1.ProjectOntoAxis(Axes[i], MinOBB1, MaxOBB1);
-            OBB2.ProjectOntoAxis(Axes[i], MinOBB2, MaxOBB2);
-
-            // ... and check whether the outermost projected points of both OBBs overlap.
-            // If this is not the case, the Separating Axis Theorem states that there can be no collision between the rectangles
-            if (!((MinOBB2<=MaxOBB1)&&(MaxOBB2>=MinOBB1)))
-                return false;
-        }
-        return true;
-    }
-}
-
-
-
-class GameObject
-{
-    public:
-        void loadTexture(std::string textureName, float vecX, float vecY)
-        {
-            if (!texture.loadFromFile(textureName))
-            {
-                std::cout<<"Error occoured!, failed to load "<<textureName<<std::endl;
-            }
-            sprite.setTexture(texture);
-            sprite.setPosition(Vector2f(vecX,vecY));
-        }
-
-        void moveSprite(float X, float Y)
-        {
-            sprite.move(X,Y);
-        }
-
-        Sprite getSprite()
-        {
-            return sprite;
-        }
-
-    private:
-        Texture texture;
-        float directionX;
-        float directionY;
-        Sprite sprite;
-};
-
-bool collision(Sprite object1, Sprite object2)
-{
-    if(Collision::PixelPerfectTest(object1,object2))
-        return true;
-    return false;
+    car.moveSprite(0, speed);
 }
 
 void reset(GameObject object[10])
@@ -819,22 +200,20 @@ void reset(GameObject object[10])
 
     object[8].loadTexture("images/south/south_black.png",385,550);
     object[9].loadTexture("images/south/south_blue.png",385,480);
-}
 
-void sleepcp(int milliseconds) // Cross-platform sleep function
-{
-    clock_t time_end;
-    time_end = clock() + milliseconds * CLOCKS_PER_SEC/1000;
-    while (clock() < time_end)
-    {
-    }
+    /// Everybody goes straight on until a resolve sends car 1 to the right
+    const int approach[10] = { Road::FromWest, Road::FromWest, Road::FromWest, Road::FromEast, Road::FromEast,
+                               Road::FromEast, Road::FromNorth, Road::FromNorth, Road::FromSouth, Road::FromSouth };
+    for(int index = 0; index < 10; index++)
+        object[index].setMovement(Road::movement(approach[index], Road::Straight));
 }
 
 int main()
 {
+    SteadyClock::time_point launched = SteadyClock::now();
     RenderWindow window(VideoMode(700, 600), "Deadlock");
     std::string data;
-    window.setFramerateLimit(60);
+    FramePacer pacer(60);
     GameObject object[10];
     GameObject object2[4];
 
@@ -842,56 +221,222 @@ int main()
     Time time;
 
     int counterCheck = 1;
+    unsigned long tick = 0;
+    bool lightsSwitched = false;
+
+    /// Event log, drained off the main loop
+    std::ofstream eventFile("events.jsonl");
+    EventLog::JsonLinesSink jsonSink(eventFile);
+    EventLog::ConsoleSink consoleSink(std::cout, EventLog::stdoutIsTerminal());
+    EventLog::Logger events({ &jsonSink, &consoleSink });
+
+    /// Metrics, served on a Unix socket and mirrored into shared memory
+    Metrics::Counter ticks, deadlocks, forecasts, textureHits, textureMisses, pairCacheHits;
+    Metrics::Counter circleRejects, boxRejects, pixelRejects, frames, snapshotsSkipped, rotatedMaskMisses;
+    Metrics::Gauge ticksPerSecond, framesPerSecond, vehiclesInFlight, firstFrame, maskBytes, maskArenaBytes, rotatedMaskBytes;
+    Metrics::Histogram frameTime(Metrics::secondsBuckets());
+    Metrics::Histogram resolveTime(Metrics::secondsBuckets());
+
+    Metrics::Registry metrics;
+    metrics.add("sfmldemo_ticks_total", "Simulation ticks.", ticks);
+    metrics.add("sfmldemo_ticks_per_second", "Ticks during the last second.", ticksPerSecond);
+    metrics.add("sfmldemo_frames_total", "Frames drawn.", frames);
+    metrics.add("sfmldemo_frames_per_second", "Frames during the last second.", framesPerSecond);
+    metrics.add("sfmldemo_snapshots_skipped_total", "Simulation ticks that were never drawn.", snapshotsSkipped);
+    metrics.add("sfmldemo_frame_seconds", "Interval between two frames.", frameTime);
+    metrics.add("sfmldemo_collision_tests_total", "Calls to collision().", collisionTests);
+    metrics.add("sfmldemo_collision_test_seconds", "Time spent in one collision() call.", collisionTestTime);
+    metrics.add("sfmldemo_collision_pair_cache_hits_total", "Collision tests answered from the pair cache.", pairCacheHits);
+    metrics.add("sfmldemo_collision_circle_rejects_total", "Collision tests ended by the bounding circles.", circleRejects);
+    metrics.add("sfmldemo_collision_box_rejects_total", "Collision tests ended by the oriented boxes.", boxRejects);
+    metrics.add("sfmldemo_collision_pixel_rejects_total", "Collision tests ended by the pixel test without contact.", pixelRejects);
+    metrics.add("sfmldemo_deadlocks_total", "Deadlocks detected.", deadlocks);
+    metrics.add("sfmldemo_forecasts_total", "Deadlock cycles predicted before contact.", forecasts);
+    metrics.add("sfmldemo_resolve_seconds", "Time from a deadlock until it was resolved.", resolveTime);
+    metrics.add("sfmldemo_time_to_first_frame_seconds", "Time from launch to the first displayed frame.", firstFrame);
+    metrics.add("sfmldemo_vehicles_in_flight", "Vehicles inside the window.", vehiclesInFlight);
+    metrics.add("sfmldemo_texture_cache_hits_total", "Bitmask lookups served from the cache.", textureHits);
+    metrics.add("sfmldemo_texture_cache_misses_total", "Bitmask lookups that had to build a mask.", textureMisses);
+    metrics.add("sfmldemo_bitmask_bytes", "Bytes of collision masks in use.", maskBytes);
+    metrics.add("sfmldemo_bitmask_arena_bytes", "Bytes reserved by the collision mask arena.", maskArenaBytes);
+    metrics.add("sfmldemo_rotated_mask_bytes", "Bytes of cached pre-rotated collision masks.", rotatedMaskBytes);
+    metrics.add("sfmldemo_rotated_mask_misses_total", "Pre-rotated masks that had to be built.", rotatedMaskMisses);
+
+    Metrics::SocketExporter exporter(metrics);
+    if (exporter.start("/tmp/" + Metrics::instanceName() + ".sock"))
+        std::cout<<"Metrics on /tmp/"<<Metrics::instanceName()<<".sock"<<std::endl;
+    Metrics::SharedStats sharedStats;
+    sharedStats.open("/" + Metrics::instanceName(), metrics);
+
+    SteadyClock::time_point lastFrame = SteadyClock::now();
+    SteadyClock::time_point rateStart = lastFrame;
+    unsigned long rateTicks = 0;
+    SteadyClock::time_point frameRateStart = lastFrame;
+    float frameSeconds = 1.f / 60;
+    unsigned long frameRateFrames = 0;
+
+    /// Decode every image in parallel, upload here on the render thread. Only the cars collide
+    AssetLoader assets;
+    if (!assets.load(AssetLoader::findImages("images"), { "images/left/", "images/right/", "images/north/", "images/south/" }))
+        std::cout<<"Error occoured!, some images failed to load"<<std::endl;
+    preloaded = &assets;
 
     /// Crossroad texture
     Texture texture;
     Sprite crossroad;
     std::string textureName = "images/crossroad.gif";
 
-    if (!texture.loadFromFile(textureName))
+    if (assets.getTexture(textureName))
+        crossroad.setTexture(*assets.getTexture(textureName));
+    else
     {
-        std::cout<<"Error occoured!, failed to load "<<textureName<<std::endl;
+        if (!texture.loadFromFile(textureName))
+        {
+            std::cout<<"Error occoured!, failed to load "<<textureName<<std::endl;
+        }
+        crossroad.setTexture(texture);
     }
-    crossroad.setTexture(texture);
     crossroad.setScale(sf::Vector2f(0.6,0.4));
 
     reset(object);
 
-    while (window.isOpen())
-    {
-        Event event;
-        while (window.pollEvent(event))
-        {
-            if (event.type == Event::Closed)
-                window.close();
-        }
+    /// Camera, the snapshots carry the grid used to draw only what it sees
+    Camera camera(700, 600);
+    std::vector<int> visible;
+
+    /// Deadlock forecast, velocities are taken from the movement since the last tick
+    Forecast::Forecaster forecaster(120);
+    std::vector<Forecast::Mover> movers;
+    Spatial::Box previous[10];
+    for(int index = 0; index < 10; index++)
+        previous[index] = object[index].getBounds();
+    bool forecastShown = false;
+
+    /// Simulation thread, publishes a snapshot of every tick for the render thread
+    TripleBuffer<Snapshot> snapshots;
+    std::atomic<bool> running(true);
+    FramePacer simPacer(60);
+
+    /// Commands are typed on the console, the simulation only polls for them
+    ConsoleReader console;
+    console.start();
+    bool awaiting = false;
+    SteadyClock::time_point blockedAt;
+    auto publish = [&]()
+    {
+        /// Only what changed since this slot was last written is copied and moved in its grid
+        Snapshot& snapshot = snapshots.write();
+        for(int id = 0; id < 14; id++)
+        {
+            GameObject& source = id < 4 ? object2[id] : object[id - 4];
+            if(snapshot.versions[id] == source.getVersion())
+                continue;
+            snapshot.versions[id] = source.getVersion();
+            (id < 4 ? snapshot.lights[id] : snapshot.cars[id - 4]) = source.getSprite();
+            snapshot.drawGrid.update(id, source.getBounds());
+        }
+        snapshot.lightsOn = data == "resolve";
+        snapshot.tick = tick;
+        snapshots.publish();
+    };
+    publish();
 
-        /// update
-        if(data == "resolve")
+    auto simulate = [&]()
+    {
+        while (running)
         {
-            counterCheck++;
-            if(counterCheck >= 67)
+            /// A deadlock holds the crossroad still until a command arrives
+            if(awaiting)
             {
-                object[0].moveSprite(1.9,0);
-                object[1].moveSprite(1.9,0);
-                object[2].moveSprite(1.9,0);
-                object[3].moveSprite(-1.5,0);
-                object[4].moveSprite(-1.5,0);
-                object[5].moveSprite(-1.5,0);
-                object[6].getSprite().setPosition(385,438);
+                std::string line;
+                if(!console.poll(line) || !(std::istringstream(line)>>data))
+                {
+                    simPacer.wait();
+                    continue;
+                }
+                awaiting = false;
+                simPacer.resetStats();
+                std::transform(data.begin(), data.end(), data.begin(), ::tolower);
+                if(data == "resolve")
+                {
+                    /// Resolve
+                    reset(object);
+                    object[1].setMovement(Road::movement(Road::FromWest, Road::Right));
+                    object2[0].loadTexture("images/traficlights/red.png",485,380);
+                    object2[1].loadTexture("images/traficlights/green.png",485,225);
+                    object2[2].loadTexture("images/traficlights/green.png",265,380);
+                    object2[3].loadTexture("images/traficlights/red.png",265,225);
+                    clock.restart();
+                    lightsSwitched = false;
+                    resolveTime.observe(secondsSince(blockedAt));
+
+                    events.log(tick, EventLog::Resolve);
+                    events.log(tick, EventLog::LightChange, EventLog::NorthEast, EventLog::Green);
+                    events.log(tick, EventLog::LightChange, EventLog::SouthEast, EventLog::Red);
+                    events.log(tick, EventLog::LightChange, EventLog::NorthWest, EventLog::Red);
+                    events.log(tick, EventLog::LightChange, EventLog::SouthWest, EventLog::Green);
 
-                if(clock.getElapsedTime().asSeconds() >= 6)
+                }
+                else
                 {
-                    object2[0].loadTexture("images/traficlights/red.png",485,225);
-                    object2[1].loadTexture("images/traficlights/green.png",485,380);//485,380
-                    object2[2].loadTexture("images/traficlights/green.png",265,225);//265,255
-                    object2[3].loadTexture("images/traficlights/red.png",265,380);
+                    std::cout<<"Wrong command\nExecuting again with Deadlock"<<std::endl;
+                    reset(object);
+                }
+                for(int index = 0; index < 10; index++)
+                    previous[index] = object[index].getBounds();
+            }
 
+            /// update. The window replays a scripted scene at fixed speeds: the tested pairs and the resolve
+            /// timing depend on them. Car following (Simulation::followLeaders) drives the headless World,
+            /// which starts from the same layout as reset()
+            if(data == "resolve")
+            {
+                counterCheck++;
+                if(counterCheck >= 67)
+                {
+                    object[0].moveSprite(1.9,0);
+                    turnRight(object[1],1.9);
+                    object[2].moveSprite(1.9,0);
+                    object[3].moveSprite(-1.5,0);
+                    object[4].moveSprite(-1.5,0);
+                    object[5].moveSprite(-1.5,0);
+                    object[6].getSprite().setPosition(385,438);
+
+                    if(clock.getElapsedTime().asSeconds() >= 6)
+                    {
+                        if(!lightsSwitched)
+                        {
+                            events.log(tick, EventLog::LightChange, EventLog::NorthEast, EventLog::Red);
+                            events.log(tick, EventLog::LightChange, EventLog::SouthEast, EventLog::Green);
+                            events.log(tick, EventLog::LightChange, EventLog::NorthWest, EventLog::Green);
+                            events.log(tick, EventLog::LightChange, EventLog::SouthWest, EventLog::Red);
+                            lightsSwitched = true;
+                        }
+                        object2[0].loadTexture("images/traficlights/red.png",485,225);
+                        object2[1].loadTexture("images/traficlights/green.png",485,380);//485,380
+                        object2[2].loadTexture("images/traficlights/green.png",265,225);//265,255
+                        object2[3].loadTexture("images/traficlights/red.png",265,380);
+
+                        object[6].moveSprite(0,1.8);
+                        object[7].moveSprite(0,1.8);
+                        object[8].moveSprite(0,-1.5);
+                        object[9].moveSprite(0,-1.5);
+                    }
+                }
+                else
+                {
+                    object[0].moveSprite(1.9,0);
+                    turnRight(object[1],1.9);
+                    object[2].moveSprite(1.9,0);
+                    object[3].moveSprite(-1.5,0);
+                    object[4].moveSprite(-1.5,0);
+                    object[5].moveSprite(-1.5,0);
                     object[6].moveSprite(0,1.8);
                     object[7].moveSprite(0,1.8);
                     object[8].moveSprite(0,-1.5);
                     object[9].moveSprite(0,-1.5);
                 }
+
             }
             else
             {
@@ -907,72 +452,164 @@ int main()
                 object[9].moveSprite(0,-1.5);
             }
 
-        }
-        else
-        {
-            object[0].moveSprite(1.9,0);
-            object[1].moveSprite(1.9,0);
-            object[2].moveSprite(1.9,0);
-            object[3].moveSprite(-1.5,0);
-            object[4].moveSprite(-1.5,0);
-            object[5].moveSprite(-1.5,0);
-            object[6].moveSprite(0,1.8);
-            object[7].moveSprite(0,1.8);
-            object[8].moveSprite(0,-1.5);
-            object[9].moveSprite(0,-1.5);
-        }
-
-        if(collision(object[2].getSprite(),object[9].getSprite()) || collision(object[5].getSprite(),object[7].getSprite()))
-        {
-            std::cout<<"There was a collison, Road Blocked!"<<std::endl;
-            std::cout<<"Enter the command \'Resolve\' to resolve the deadlock: ";
-            std::cin>>data;
-            std::transform(data.begin(), data.end(), data.begin(), ::tolower);
-            if(data == "resolve")
+            movers.clear();
+            for(int index = 0; index < 10; index++)
             {
-                /// Resolve
-                reset(object);
-                object2[0].loadTexture("images/traficlights/red.png",485,380);
-                object2[1].loadTexture("images/traficlights/green.png",485,225);
-                object2[2].loadTexture("images/traficlights/green.png",265,380);
-                object2[3].loadTexture("images/traficlights/red.png",265,225);
-                clock.restart();
-
+                Spatial::Box box = object[index].getBounds();
+                Forecast::Mover mover = Forecast::bodyOf(index, box.left, box.top, box.width, box.height,
+                                                         box.left - previous[index].left, box.top - previous[index].top);
+                movers.push_back(mover);
+                previous[index] = box;
             }
-            else
+            const std::vector<Forecast::Cycle>& cycles = forecaster.run(movers);
+            if(!cycles.empty() && !forecastShown)
             {
-                std::cout<<"Wrong command\nExecuting again with Deadlock"<<std::endl;
-                reset(object);
+                const Forecast::Cycle& soonest = cycles.front();
+                events.log(tick, EventLog::Forecast, movers[soonest.movers[0]].id, movers[soonest.movers[1]].id, int(std::ceil(soonest.time)));
+                forecasts.add();
             }
-        }
+            forecastShown = !cycles.empty();
 
-        window.clear();
+            /// The two pairs that block each other, then the right turner against the southbound lane it merges into.
+            /// Only movements the road model says conflict can deadlock, the pixel test confirms they touched
+            const int tested[4][2] = { {2,9}, {5,7}, {1,6}, {1,7} };
+            int collided = -1, other = -1;
+            for(int index = 0; index < 4 && collided < 0; index++)
+            {
+                GameObject& first = object[tested[index][0]];
+                GameObject& second = object[tested[index][1]];
+                if(!Road::conflicts(first.getMovement(), second.getMovement()))
+                    continue;
+                if(collision(object,tested[index][0],tested[index][1]))
+                {
+                    collided = tested[index][0];
+                    other = tested[index][1];
+                }
+            }
 
-        /// Draw
-        window.draw(crossroad);
-        if(data == "resolve")
-        {
-            for(int index = 0; index< 4; index++)
+            if(collided >= 0)
             {
-                window.draw(object2[index].getSprite());
+                events.log(tick, EventLog::Collision, collided, other);
+                events.log(tick, EventLog::Deadlock, collided, other);
+                deadlocks.add();
+                blockedAt = SteadyClock::now();
+                events.flush();
+                std::cout<<"Enter the command \'Resolve\' to resolve the deadlock: "<<std::flush;
+                awaiting = true;
             }
 
+            publish();
+            simPacer.wait();
+            tick++;
+
+            ticks.add();
+            rateTicks++;
+            double rateWindow = secondsSince(rateStart);
+            if(rateWindow >= 1)
+            {
+                ticksPerSecond.set(rateTicks / rateWindow);
+                rateStart = SteadyClock::now();
+                rateTicks = 0;
+            }
 
+            int inFlight = 0;
             for(int index = 0; index < 10; index++)
             {
-                window.draw(object[index].getSprite());
+                Vector2f position = object[index].getSprite().getPosition();
+                if(position.x > -48 && position.x < 700 && position.y > -48 && position.y < 600)
+                    inFlight++;
             }
+            vehiclesInFlight.set(inFlight);
+            textureHits.store(Collision::Bitmasks.Hits);
+            textureMisses.store(Collision::Bitmasks.Misses);
+            maskBytes.set(double(Collision::Bitmasks.GetMaskBytes()));
+            maskArenaBytes.set(double(Collision::Bitmasks.GetArenaBytes()));
+            rotatedMaskBytes.set(double(Collision::RotatedMasks.GetBytes()));
+            rotatedMaskMisses.store(Collision::RotatedMasks.Misses);
+            pairCacheHits.store(collisionCache.Hits);
+            circleRejects.store(Collision::Cascade.CircleRejects);
+            boxRejects.store(Collision::Cascade.BoxRejects);
+            pixelRejects.store(Collision::Cascade.PixelRejects);
         }
-        else
+    };
+    std::thread simulation(simulate);
+
+    /// Render thread, draws the newest snapshot whatever the simulation is doing
+    unsigned long frame = 0;
+    while (window.isOpen())
+    {
+        Event event;
+        while (window.pollEvent(event))
         {
-            for(int index = 0; index < 10; index++)
+            if (event.type == Event::Closed)
+                window.close();
+            camera.handleEvent(event, window);
+        }
+        camera.update(std::min(frameSeconds, 0.1f), window);
+
+        snapshots.update();
+        Snapshot& latest = snapshots.read();
+
+        window.clear();
+
+        /// Draw, lights first so the cars pass over them
+        window.setView(camera.getView());
+        window.draw(crossroad);
+
+        latest.drawGrid.query(camera.visibleArea(), visible);
+        std::sort(visible.begin(), visible.end());
+        for(int id : visible)
+        {
+            if(id < 4)
             {
-                window.draw(object[index].getSprite());
+                if(latest.lightsOn)
+                    window.draw(latest.lights[id]);
             }
+            else
+                window.draw(latest.cars[id - 4]);
         }
         /// Display
         window.display();
-    }
+        if(frame == 0)
+        {
+            firstFrame.set(secondsSince(launched));
+            std::cout<<"First frame after "<<firstFrame.value() * 1000<<" ms ("<<assets.size()<<" images decoded in "
+                     <<assets.decodeSeconds * 1000<<" ms on "<<assets.threadCount<<" threads, uploaded in "
+                     <<assets.uploadSeconds * 1000<<" ms)"<<std::endl;
+        }
+        pacer.wait();
+        frame++;
+
+        /// Metrics
+        SteadyClock::time_point now = SteadyClock::now();
+        frameSeconds = std::chrono::duration<float>(now - lastFrame).count();
+        frameTime.observe(frameSeconds);
+        lastFrame = now;
+        frames.add();
+        frameRateFrames++;
+        double frameWindow = secondsSince(frameRateStart);
+        if(frameWindow >= 1)
+        {
+            framesPerSecond.set(frameRateFrames / frameWindow);
+            frameRateStart = now;
+            frameRateFrames = 0;
+        }
+        snapshotsSkipped.store(snapshots.getSkipped());
+        sharedStats.publish(metrics);
+    }
+
+    /// The simulation never blocks on the console, so it always finishes its tick and stops
+    running = false;
+    simulation.join();
+    console.stop();
+
+    std::cout<<"Simulation thread: ";
+    simPacer.report(std::cout);
+    std::cout<<"Render thread: ";
+    pacer.report(std::cout);
+    std::cout<<"Collision tests: "<<Collision::Cascade.Tests<<", ended by circles "<<Collision::Cascade.CircleRejects
+             <<", boxes "<<Collision::Cascade.BoxRejects<<", pixels "<<Collision::Cascade.PixelRejects
+             <<", collisions "<<Collision::Cascade.Collisions<<std::endl;
 
     return 0;
 }
@@ -0,0 +1,430 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+// Runtime metrics. Counters, gauges and histograms are plain atomics that the
+// main loop updates without locks. A background thread serves them in the
+// Prometheus text format over a Unix domain socket, and publish() mirrors them
+// into a seqlock protected shared memory page that local readers can poll
+// without a single syscall on the simulation side.
+
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#   define METRICS_POSIX
+#   include <sys/socket.h>
+#   include <sys/un.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <poll.h>
+#   include <unistd.h>
+#   include <cerrno>
+#endif
+
+// A scraper that hangs up before the reply must not raise SIGPIPE and kill the process
+#if defined(MSG_NOSIGNAL)
+#   define METRICS_SEND_FLAGS MSG_NOSIGNAL
+#else
+#   define METRICS_SEND_FLAGS 0
+#endif
+
+namespace Metrics
+{
+    class Counter
+    {
+    public:
+        Counter() : count(0) {}
+
+        void add(std::uint64_t amount = 1) { count.fetch_add(amount, std::memory_order_relaxed); }
+
+        /// For totals that are already counted elsewhere, such as the bitmask cache hits
+        void store(std::uint64_t total) { count.store(total, std::memory_order_relaxed); }
+
+        std::uint64_t value() const { return count.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<std::uint64_t> count;
+    };
+
+    class Gauge
+    {
+    public:
+        Gauge() : current(0.0) {}
+
+        void set(double value) { current.store(value, std::memory_order_relaxed); }
+        double value() const { return current.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<double> current;
+    };
+
+    class Histogram
+    {
+    public:
+        /// Upper bounds of the buckets in ascending order, +Inf is added implicitly
+        explicit Histogram(const std::vector<double>& bounds)
+            : bounds(bounds), buckets(new std::atomic<std::uint64_t>[bounds.size() + 1]), total(0), sum(0.0)
+        {
+            for (std::size_t index = 0; index <= bounds.size(); index++)
+                buckets[index] = 0;
+        }
+
+        void observe(double value)
+        {
+            std::size_t index = 0;
+            while (index < bounds.size() && value > bounds[index])
+                index++;
+            buckets[index].fetch_add(1, std::memory_order_relaxed);
+            total.fetch_add(1, std::memory_order_relaxed);
+
+            double old = sum.load(std::memory_order_relaxed);
+            while (!sum.compare_exchange_weak(old, old + value, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        std::uint64_t count() const { return total.load(std::memory_order_relaxed); }
+        double getSum() const { return sum.load(std::memory_order_relaxed); }
+        const std::vector<double>& getBounds() const { return bounds; }
+        std::uint64_t bucket(std::size_t index) const { return buckets[index].load(std::memory_order_relaxed); }
+
+    private:
+        std::vector<double> bounds;
+        std::unique_ptr<std::atomic<std::uint64_t>[]> buckets;
+        std::atomic<std::uint64_t> total;
+        std::atomic<double> sum;
+    };
+
+    /// Buckets from 1/16 ms to 1 s, for anything timed in seconds
+    inline std::vector<double> secondsBuckets()
+    {
+        std::vector<double> bounds;
+        for (double bound = 0.0000625; bound <= 1.0; bound *= 2)
+            bounds.push_back(bound);
+        return bounds;
+    }
+
+    class Registry
+    {
+    public:
+        void add(const std::string& name, const std::string& help, const Counter& counter)
+        {
+            entries.push_back(Entry{ name, help, &counter, 0, 0 });
+        }
+
+        void add(const std::string& name, const std::string& help, const Gauge& gauge)
+        {
+            entries.push_back(Entry{ name, help, 0, &gauge, 0 });
+        }
+
+        void add(const std::string& name, const std::string& help, const Histogram& histogram)
+        {
+            entries.push_back(Entry{ name, help, 0, 0, &histogram });
+        }
+
+        std::string renderPrometheus() const
+        {
+            std::ostringstream text;
+            for (const Entry& entry : entries)
+            {
+                text<<"# HELP "<<entry.name<<' '<<entry.help<<'\n';
+                if (entry.counter)
+                {
+                    text<<"# TYPE "<<entry.name<<" counter\n";
+                    text<<entry.name<<' '<<entry.counter->value()<<'\n';
+                }
+                else if (entry.gauge)
+                {
+                    text<<"# TYPE "<<entry.name<<" gauge\n";
+                    text<<entry.name<<' '<<entry.gauge->value()<<'\n';
+                }
+                else
+                {
+                    const Histogram& histogram = *entry.histogram;
+                    text<<"# TYPE "<<entry.name<<" histogram\n";
+                    std::uint64_t cumulative = 0;
+                    for (std::size_t index = 0; index < histogram.getBounds().size(); index++)
+                    {
+                        cumulative += histogram.bucket(index);
+                        text<<entry.name<<"_bucket{le=\""<<histogram.getBounds()[index]<<"\"} "<<cumulative<<'\n';
+                    }
+                    cumulative += histogram.bucket(histogram.getBounds().size());
+                    text<<entry.name<<"_bucket{le=\"+Inf\"} "<<cumulative<<'\n';
+                    text<<entry.name<<"_sum "<<histogram.getSum()<<'\n';
+                    text<<entry.name<<"_count "<<histogram.count()<<'\n';
+                }
+            }
+            return text.str();
+        }
+
+        /// Names of the flat values used by the shared page; histograms become _count and _sum
+        std::vector<std::string> valueNames() const
+        {
+            std::vector<std::string> names;
+            for (const Entry& entry : entries)
+            {
+                if (entry.histogram)
+                {
+                    names.push_back(entry.name + "_count");
+                    names.push_back(entry.name + "_sum");
+                }
+                else
+                    names.push_back(entry.name);
+            }
+            return names;
+        }
+
+        /// The flat values in the order of valueNames(), without allocating
+        int values(double* out, int capacity) const
+        {
+            int count = 0;
+            for (const Entry& entry : entries)
+            {
+                if (entry.counter && count < capacity)
+                    out[count++] = double(entry.counter->value());
+                else if (entry.gauge && count < capacity)
+                    out[count++] = entry.gauge->value();
+                else if (entry.histogram && count + 1 < capacity)
+                {
+                    out[count++] = double(entry.histogram->count());
+                    out[count++] = entry.histogram->getSum();
+                }
+            }
+            return count;
+        }
+
+    private:
+        struct Entry
+        {
+            std::string name;
+            std::string help;
+            const Counter* counter;
+            const Gauge* gauge;
+            const Histogram* histogram;
+        };
+
+        std::vector<Entry> entries;
+    };
+
+    /// Several instances can run on one host, so sockets and pages carry the process id
+    inline std::string instanceName()
+    {
+    #if defined(METRICS_POSIX)
+        std::ostringstream name;
+        name<<"sfmldemo-"<<getpid();
+        return name.str();
+    #else
+        return "sfmldemo";
+    #endif
+    }
+
+    /// Layout of the shared page. Readers copy the values while sequence is even
+    /// and unchanged before and after the copy.
+    struct SharedPage
+    {
+        static const std::uint32_t Magic = 0x5346444d; // "SFDM"
+        static const int MaxValues = 48;
+
+        std::uint32_t magic;
+        std::uint32_t valueCount;
+        std::atomic<std::uint32_t> sequence;
+        std::uint32_t reserved;
+        char names[MaxValues][56];
+        double values[MaxValues];
+    };
+
+    class SharedStats
+    {
+    public:
+        SharedStats() : page(0), name() {}
+
+        ~SharedStats() { close(); }
+
+        /// Create the page and write the value names, publish() only touches memory afterwards
+        bool open(const std::string& shmName, const Registry& registry)
+        {
+        #if defined(METRICS_POSIX)
+            int fd = shm_open(shmName.c_str(), O_CREAT | O_RDWR, 0644);
+            if (fd < 0)
+                return false;
+            if (ftruncate(fd, sizeof(SharedPage)) != 0)
+            {
+                ::close(fd);
+                return false;
+            }
+            void* memory = mmap(0, sizeof(SharedPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (memory == MAP_FAILED)
+                return false;
+
+            page = new (memory) SharedPage;
+            name = shmName;
+            page->magic = SharedPage::Magic;
+            page->sequence.store(0, std::memory_order_relaxed);
+
+            std::vector<std::string> names = registry.valueNames();
+            int count = 0;
+            for (; count < int(names.size()) && count < SharedPage::MaxValues; count++)
+            {
+                std::strncpy(page->names[count], names[count].c_str(), sizeof(page->names[count]) - 1);
+                page->names[count][sizeof(page->names[count]) - 1] = 0;
+            }
+            page->valueCount = count;
+            return true;
+        #else
+            (void)shmName;
+            (void)registry;
+            return false;
+        #endif
+        }
+
+        void publish(const Registry& registry)
+        {
+            if (!page)
+                return;
+
+            std::uint32_t sequence = page->sequence.load(std::memory_order_relaxed);
+            page->sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            registry.values(page->values, page->valueCount);
+
+            page->sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        void close()
+        {
+        #if defined(METRICS_POSIX)
+            if (page)
+            {
+                munmap(page, sizeof(SharedPage));
+                shm_unlink(name.c_str());
+                page = 0;
+            }
+        #endif
+        }
+
+    private:
+        SharedPage* page;
+        std::string name;
+    };
+
+    /// Answers every connection on the socket with the current metrics as a plain HTTP
+    /// response, so `curl --unix-socket <path> http://localhost/metrics` works
+    class SocketExporter
+    {
+    public:
+        explicit SocketExporter(const Registry& registry) : registry(registry), listener(-1), running(false) {}
+
+        ~SocketExporter() { stop(); }
+
+        bool start(const std::string& socketPath)
+        {
+        #if defined(METRICS_POSIX)
+            sockaddr_un address;
+            std::memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            if (socketPath.size() >= sizeof(address.sun_path))
+                return false;
+            std::strcpy(address.sun_path, socketPath.c_str());
+
+            listener = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listener < 0)
+                return false;
+            unlink(socketPath.c_str());
+            if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 4) != 0)
+            {
+                ::close(listener);
+                listener = -1;
+                return false;
+            }
+
+            path = socketPath;
+            running = true;
+            server = std::thread(&SocketExporter::serve, this);
+            return true;
+        #else
+            (void)socketPath;
+            return false;
+        #endif
+        }
+
+        void stop()
+        {
+        #if defined(METRICS_POSIX)
+            if (!running)
+                return;
+            running = false;
+            server.join();
+            ::close(listener);
+            unlink(path.c_str());
+            listener = -1;
+        #endif
+        }
+
+    private:
+        void serve()
+        {
+        #if defined(METRICS_POSIX)
+            while (running)
+            {
+                pollfd waiting = { listener, POLLIN, 0 };
+                if (poll(&waiting, 1, 200) <= 0)
+                    continue;
+
+                int client = accept(listener, 0, 0);
+                if (client < 0)
+                    continue;
+            #if defined(SO_NOSIGPIPE)
+                int noSignal = 1;
+                setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &noSignal, sizeof(noSignal));
+            #endif
+
+                // The request itself does not matter, but read it so the client sees a clean close
+                char request[1024];
+                pollfd readable = { client, POLLIN, 0 };
+                if (poll(&readable, 1, 100) > 0)
+                {
+                    ssize_t ignored = recv(client, request, sizeof(request), 0);
+                    (void)ignored;
+                }
+
+                std::string body = registry.renderPrometheus();
+                std::ostringstream response;
+                response<<"HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+                        <<body.size()<<"\r\n\r\n"<<body;
+                std::string text = response.str();
+
+                std::size_t sent = 0;
+                while (sent < text.size())
+                {
+                    ssize_t written = send(client, text.data() + sent, text.size() - sent, METRICS_SEND_FLAGS);
+                    if (written < 0 && errno == EINTR)
+                        continue;
+                    // EPIPE and ECONNRESET are just a client that went away
+                    if (written <= 0)
+                        break;
+                    sent += written;
+                }
+                ::close(client);
+            }
+        #endif
+        }
+
+        const Registry& registry;
+        int listener;
+        std::atomic<bool> running;
+        std::string path;
+        std::thread server;
+    };
+}
+
+#endif // METRICS_H
@@ -0,0 +1,135 @@
+#ifndef ROADMODEL_H
+#define ROADMODEL_H
+
+// Lanes and turning movements of the four-way crossroad. The box where the
+// roads cross is split into four cells; every movement sweeps a fixed run of
+// cells, and two movements conflict when their runs share a cell. The
+// resulting 12x12 conflict matrix is computed at compile time.
+
+#include <array>
+
+namespace Road
+{
+    /// Side of the crossroad a vehicle enters from (images/left, right, north, south)
+    enum Approach { FromWest, FromEast, FromNorth, FromSouth, ApproachCount };
+
+    enum Turn { Right, Straight, Left, TurnCount };
+
+    const int MovementCount = ApproachCount * TurnCount;
+
+    /// Cells of the box; traffic keeps to the right, so eastbound cars use the southern half
+    enum Cell { NorthWest = 1, SouthWest = 2, SouthEast = 4, NorthEast = 8 };
+
+    constexpr int movement(int approach, int turn)
+    {
+        return approach * TurnCount + turn;
+    }
+
+    constexpr int approachOf(int movement) { return movement / TurnCount; }
+    constexpr int turnOf(int movement) { return movement % TurnCount; }
+
+    /// First cell a car from this approach drives into
+    constexpr int entryCell(int approach)
+    {
+        return approach == FromNorth ? 0 : approach == FromWest ? 1 : approach == FromSouth ? 2 : 3;
+    }
+
+    /// Cells in driving order; right turns use one, straight two and left turns three of them
+    constexpr unsigned cellInOrder(int index)
+    {
+        const unsigned order[4] = { NorthWest, SouthWest, SouthEast, NorthEast };
+        return order[index % 4];
+    }
+
+    constexpr int cellCount(int turn)
+    {
+        return turn + 1;
+    }
+
+    constexpr unsigned cellsOf(int movement)
+    {
+        unsigned cells = 0;
+        for (int index = 0; index < cellCount(turnOf(movement)); index++)
+            cells |= cellInOrder(entryCell(approachOf(movement)) + index);
+        return cells;
+    }
+
+    /// Approach whose outbound lane a movement leaves by
+    constexpr int exitApproach(int movement)
+    {
+        // Cells in driving order end next to the outbound lane of the approach that enters one cell later
+        const int byEntryCell[4] = { FromNorth, FromWest, FromSouth, FromEast };
+        return byEntryCell[(entryCell(approachOf(movement)) + cellCount(turnOf(movement))) % 4];
+    }
+
+    typedef std::array<std::array<bool, MovementCount>, MovementCount> ConflictMatrix;
+
+    constexpr ConflictMatrix makeConflicts()
+    {
+        ConflictMatrix conflicts = {};
+        for (int first = 0; first < MovementCount; first++)
+        {
+            for (int second = 0; second < MovementCount; second++)
+            {
+                // Cars from the same approach share a lane and queue instead
+                bool sameLane = approachOf(first) == approachOf(second);
+                bool sharedCell = (cellsOf(first) & cellsOf(second)) != 0;
+                bool sameExit = exitApproach(first) == exitApproach(second);
+                conflicts[first][second] = !sameLane && (sharedCell || sameExit);
+            }
+        }
+        return conflicts;
+    }
+
+    constexpr ConflictMatrix Conflicts = makeConflicts();
+
+    static_assert(!Conflicts[movement(FromWest, Straight)][movement(FromEast, Straight)], "opposite through traffic");
+    static_assert(Conflicts[movement(FromWest, Straight)][movement(FromSouth, Straight)], "crossing through traffic");
+    static_assert(Conflicts[movement(FromWest, Left)][movement(FromEast, Straight)], "left turn across oncoming traffic");
+    static_assert(!Conflicts[movement(FromWest, Right)][movement(FromEast, Right)], "opposite right turns");
+    static_assert(Conflicts[movement(FromWest, Right)][movement(FromNorth, Straight)], "merging into the same lane");
+    static_assert(exitApproach(movement(FromWest, Straight)) == FromEast, "straight on leaves on the far side");
+
+    inline bool conflicts(int first, int second)
+    {
+        return Conflicts[first][second];
+    }
+
+    /// Length of a movement's path through the box, split evenly between its cells
+    inline float routeLength(int turn, float boxSize)
+    {
+        return boxSize * cellCount(turn) / 2.f;
+    }
+
+    /// A car's extent along its route through the box; negative before it enters
+    struct Occupancy
+    {
+        int movement;
+        float rear, front;
+    };
+
+    /// Cells covered by the part of the car that is inside the box
+    inline unsigned occupiedCells(const Occupancy& occupancy, float boxSize)
+    {
+        int turn = turnOf(occupancy.movement);
+        float cellLength = routeLength(turn, boxSize) / cellCount(turn);
+        unsigned cells = 0;
+        for (int index = 0; index < cellCount(turn); index++)
+        {
+            float start = index * cellLength;
+            if (occupancy.front > start && occupancy.rear < start + cellLength)
+                cells |= cellInOrder(entryCell(approachOf(occupancy.movement)) + index);
+        }
+        return cells;
+    }
+
+    /// Conflict check for two cars inside the box: table lookup first, then the cells they cover
+    inline bool conflicts(const Occupancy& first, const Occupancy& second, float boxSize)
+    {
+        if (!Conflicts[first.movement][second.movement])
+            return false;
+        return (occupiedCells(first, boxSize) & occupiedCells(second, boxSize)) != 0;
+    }
+}
+
+#endif // ROADMODEL_H
@@ -0,0 +1,520 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+// Headless model of the crossroad in main(). Vehicles are reduced to a
+// distance travelled along their lane and a speed, so thousands of seeded
+// runs can be stepped without a window, textures or SFML at all.
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "roadmodel.hpp"
+#include "forecast.hpp"
+
+namespace Simulation
+{
+    using namespace Road;
+
+    enum LightPolicy { NoLights, FixedCycle, PolicyCount };
+
+    const float VehicleSize = 48.f;     // every car image is 48x48
+    const float TicksPerSecond = 60.f;  // window.setFramerateLimit(60)
+
+    /// The area where the two roads cross, in window coordinates
+    const float BoxLeft = 340.f, BoxRight = 433.f;
+    const float BoxTop = 265.f, BoxBottom = 358.f;
+    const float BoxSize = 93.f;
+
+    struct Lane
+    {
+        float originX, originY;  // sprite position at distance 0, just off screen
+        float dirX, dirY;
+        float speed;             // the moveSprite() constants in main()
+        float length;            // distance after which the vehicle has left the window
+    };
+
+    const Lane Lanes[ApproachCount] = {
+        { -48.f, 310.f,  1.f,  0.f, 1.9f, 748.f },
+        { 700.f, 265.f, -1.f,  0.f, 1.5f, 748.f },
+        { 340.f, -48.f,  0.f,  1.f, 1.8f, 648.f },
+        { 385.f, 600.f,  0.f, -1.f, 1.5f, 648.f }
+    };
+
+    inline bool isHorizontal(int approach)
+    {
+        return approach == FromWest || approach == FromEast;
+    }
+
+    /// Distance along the lane at which the front bumper reaches the box
+    inline float enterDistance(int approach)
+    {
+        const Lane& lane = Lanes[approach];
+        float origin = isHorizontal(approach) ? lane.originX : lane.originY;
+        float dir = isHorizontal(approach) ? lane.dirX : lane.dirY;
+        float nearEdge = isHorizontal(approach) ? BoxLeft : BoxTop;
+        float farEdge = isHorizontal(approach) ? BoxRight : BoxBottom;
+        return dir > 0 ? nearEdge - origin - VehicleSize : origin - farEdge;
+    }
+
+    /// Distance along the lane at which the rear bumper has left the box
+    inline float exitDistance(int approach)
+    {
+        const Lane& lane = Lanes[approach];
+        float origin = isHorizontal(approach) ? lane.originX : lane.originY;
+        float dir = isHorizontal(approach) ? lane.dirX : lane.dirY;
+        float nearEdge = isHorizontal(approach) ? BoxLeft : BoxTop;
+        float farEdge = isHorizontal(approach) ? BoxRight : BoxBottom;
+        return dir > 0 ? farEdge - origin : origin + VehicleSize - nearEdge;
+    }
+
+    struct Vehicle
+    {
+        int id;
+        int approach;
+        int movement;
+        float distance;
+        float speed;
+        float x, y;  // top left corner, same convention as Sprite::getPosition()
+    };
+
+    /// Intelligent driver model, in pixels and ticks
+    struct DriverModel
+    {
+        float maxAccel = 0.05f;
+        float comfortBrake = 0.1f;
+        float hardBrake = 0.3f;  // still stopping for a light that just turned red
+        float minGap = 6.f;
+        float headway = 10.f;    // ticks
+    };
+
+    struct Parameters
+    {
+        float arrivalRate = 0.5f;   // vehicles per second and approach
+        float speedMix = 0.f;       // speeds are drawn from lane speed * (1 +- speedMix)
+        int lightPolicy = NoLights;
+        int greenTicks = 240;       // FixedCycle: green time per axis
+        int clearanceTicks = 120;   // FixedCycle: all red between the phases
+        int maxTicks = 3600;
+        float collisionInset = Forecast::ImageBorder;
+        bool startFromReset = true; // begin with the ten cars placed by reset()
+        float upstream = 0.f;       // lane length before the window edge, for long queues
+        float exitRate = 0.f;       // vehicles per second the road beyond the window takes, 0 = unlimited
+        float forecastHorizon = 0.f; // ticks to look ahead for deadlock cycles, 0 = off
+        int maxVehicles = 0;        // no arrivals while this many cars are in the window, 0 = unlimited
+        DriverModel driver;
+    };
+
+    struct RunResult
+    {
+        bool deadlocked = false;
+        int firstDeadlockTick = -1;
+        int firstForecastTick = -1; // first tick a deadlock cycle was predicted
+        int forecastSince = -1;     // start of the prediction still standing, -1 if there is none
+        int ticks = 0;
+        int spawned = 0;
+        int exited = 0;
+
+        float throughput() const // vehicles per second leaving the window
+        {
+            return ticks > 0 ? exited * TicksPerSecond / ticks : 0.f;
+        }
+    };
+
+    /// splitmix64, so a run only depends on its seed and not on the standard library
+    class Random
+    {
+    public:
+        explicit Random(std::uint64_t seed) : state(seed) {}
+
+        std::uint64_t next()
+        {
+            std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        double uniform() // [0, 1)
+        {
+            return (next() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+    private:
+        std::uint64_t state;
+    };
+
+    /// The cars on one approach, front-most first, stored as parallel arrays so
+    /// the car-following pass runs as straight loops over floats
+    struct LaneState
+    {
+        std::vector<int> ids;
+        std::vector<int> movements;
+        std::vector<float> distance;
+        std::vector<float> speed;
+        std::vector<float> desired;
+
+        // Scratch for the car-following pass
+        std::vector<float> leaderRear;
+        std::vector<float> leaderSpeed;
+
+        float exitTokens = 0.f;
+
+        std::size_t size() const { return ids.size(); }
+
+        void insert(std::size_t index, int id, int movement, float at, float velocity, float wanted)
+        {
+            ids.insert(ids.begin() + index, id);
+            movements.insert(movements.begin() + index, movement);
+            distance.insert(distance.begin() + index, at);
+            speed.insert(speed.begin() + index, velocity);
+            desired.insert(desired.begin() + index, wanted);
+        }
+
+        void eraseFront(std::size_t count)
+        {
+            ids.erase(ids.begin(), ids.begin() + count);
+            movements.erase(movements.begin(), movements.begin() + count);
+            distance.erase(distance.begin(), distance.begin() + count);
+            speed.erase(speed.begin(), speed.begin() + count);
+            desired.erase(desired.begin(), desired.begin() + count);
+        }
+
+        void clear()
+        {
+            eraseFront(size());
+        }
+    };
+
+    /// One car-following step for a whole lane. Every car reacts to the rear
+    /// of the car ahead (or an obstacle such as a red stop line) as it was at
+    /// the start of the tick, so the loop has no dependency between iterations.
+    inline void followLeaders(LaneState& lane, const DriverModel& driver)
+    {
+        std::size_t count = lane.size();
+        float* __restrict distance = lane.distance.data();
+        float* __restrict speed = lane.speed.data();
+        const float* __restrict desired = lane.desired.data();
+        const float* __restrict leaderRear = lane.leaderRear.data();
+        const float* __restrict leaderSpeed = lane.leaderSpeed.data();
+
+        const float maxAccel = driver.maxAccel;
+        const float minGap = driver.minGap;
+        const float headway = driver.headway;
+        const float brakeTerm = 1.f / (2.f * std::sqrt(driver.maxAccel * driver.comfortBrake));
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            float v = speed[i];
+            float gap = std::max(leaderRear[i] - distance[i], 0.01f);
+            float wanted = minGap + std::max(0.f, v * headway + v * (v - leaderSpeed[i]) * brakeTerm);
+            float ratio = v / desired[i];
+            ratio *= ratio;
+            float crowding = wanted / gap;
+            float accel = maxAccel * (1.f - ratio * ratio - crowding * crowding);
+
+            float next = std::min(distance[i] + std::max(v + accel, 0.f), std::max(distance[i], leaderRear[i]));
+            speed[i] = next - distance[i];
+            distance[i] = next;
+        }
+    }
+
+    class World
+    {
+    public:
+        World(const Parameters& params, std::uint64_t seed)
+            : params(params), random(seed), tick(0), nextId(0), forecaster(params.forecastHorizon)
+        {
+            if (params.startFromReset)
+                reset();
+        }
+
+        /// Same starting layout as reset(object) in main()
+        void reset()
+        {
+            for (int approach = 0; approach < ApproachCount; approach++)
+                lanes[approach].clear();
+            spawn(FromWest, 48.f);
+            spawn(FromWest, 108.f);
+            spawn(FromWest, 178.f);
+            spawn(FromEast, 0.f);
+            spawn(FromEast, 70.f);
+            spawn(FromEast, 150.f);
+            spawn(FromNorth, 48.f);
+            spawn(FromNorth, 108.f);
+            spawn(FromSouth, 50.f);
+            spawn(FromSouth, 120.f);
+        }
+
+        bool isGreen(int approach) const
+        {
+            if (params.lightPolicy != FixedCycle)
+                return true;
+
+            int cycle = 2 * (params.greenTicks + params.clearanceTicks);
+            int phase = tick % cycle;
+            if (isHorizontal(approach))
+                return phase < params.greenTicks;
+            return phase >= params.greenTicks + params.clearanceTicks
+                && phase < 2 * params.greenTicks + params.clearanceTicks;
+        }
+
+        /// One tick; false once the crossroad is deadlocked
+        bool step()
+        {
+            advance();
+
+            if (params.forecastHorizon > 0.f)
+            {
+                if (forecast().empty())
+                    result.forecastSince = -1;
+                else
+                {
+                    if (result.forecastSince < 0)
+                        result.forecastSince = tick;
+                    if (result.firstForecastTick < 0)
+                        result.firstForecastTick = tick;
+                }
+            }
+
+            return !checkDeadlock();
+        }
+
+        /// Arrivals and car following, the first half of step()
+        void advance()
+        {
+            arrivals();
+            move();
+            tick++;
+            result.ticks = tick;
+        }
+
+        /// The second half of step()
+        bool checkDeadlock()
+        {
+            if (!blocked())
+                return false;
+            result.deadlocked = true;
+            result.firstDeadlockTick = tick;
+            return true;
+        }
+
+        RunResult run()
+        {
+            while (tick < params.maxTicks && step())
+            {
+            }
+            return result;
+        }
+
+        int vehicleCount() const
+        {
+            int count = 0;
+            for (int approach = 0; approach < ApproachCount; approach++)
+                count += int(lanes[approach].size());
+            return count;
+        }
+
+        /// Positions of every car, for drawing or debugging
+        void collectVehicles(std::vector<Vehicle>& out) const
+        {
+            out.clear();
+            for (int approach = 0; approach < ApproachCount; approach++)
+            {
+                const LaneState& lane = lanes[approach];
+                for (std::size_t index = 0; index < lane.size(); index++)
+                {
+                    Vehicle vehicle;
+                    vehicle.id = lane.ids[index];
+                    vehicle.approach = approach;
+                    vehicle.movement = lane.movements[index];
+                    vehicle.distance = lane.distance[index];
+                    vehicle.speed = lane.speed[index];
+                    vehicle.x = Lanes[approach].originX + Lanes[approach].dirX * vehicle.distance;
+                    vehicle.y = Lanes[approach].originY + Lanes[approach].dirY * vehicle.distance;
+                    out.push_back(vehicle);
+                }
+            }
+        }
+
+        /// Deadlock cycles expected within the horizon if every car keeps its current velocity
+        const std::vector<Forecast::Cycle>& forecast()
+        {
+            movers.clear();
+            for (int approach = 0; approach < ApproachCount; approach++)
+            {
+                const LaneState& lane = lanes[approach];
+                float stopLine = 0.f;
+                std::size_t stopping = firstStopping(approach, stopLine);
+                for (std::size_t index = 0; index < lane.size(); index++)
+                {
+                    const Lane& road = Lanes[approach];
+                    Forecast::Mover mover = Forecast::bodyOf(lane.ids[index],
+                                                             road.originX + road.dirX * lane.distance[index],
+                                                             road.originY + road.dirY * lane.distance[index],
+                                                             VehicleSize, VehicleSize,
+                                                             road.dirX * lane.speed[index], road.dirY * lane.speed[index],
+                                                             params.collisionInset);
+                    if (index >= stopping)
+                        mover.stop = lane.speed[index] > 0.f ? std::max(stopLine - lane.distance[index], 0.f) / lane.speed[index] : 0.f;
+                    movers.push_back(mover);
+                }
+            }
+            return forecaster.run(movers);
+        }
+
+        const LaneState& getLane(int approach) const { return lanes[approach]; }
+        const RunResult& getResult() const { return result; }
+        int getTick() const { return tick; }
+
+    private:
+        void spawn(int approach, float distance)
+        {
+            float mix = params.speedMix * float(2.0 * random.uniform() - 1.0);
+            float wanted = Lanes[approach].speed * (1.f + mix);
+
+            LaneState& lane = lanes[approach];
+            std::size_t index = lane.size();
+            while (index > 0 && lane.distance[index - 1] < distance)
+                index--;
+
+            // Join the back of a queue no faster than the car ahead
+            float velocity = index > 0 ? std::min(wanted, lane.speed[index - 1]) : wanted;
+            lane.insert(index, nextId++, movement(approach, Straight), distance, velocity, wanted);
+            result.spawned++;
+        }
+
+        void arrivals()
+        {
+            double chance = params.arrivalRate / TicksPerSecond;
+            int count = vehicleCount();
+            for (int approach = 0; approach < ApproachCount; approach++)
+            {
+                if (random.uniform() >= chance || (params.maxVehicles > 0 && count >= params.maxVehicles))
+                    continue;
+
+                // A new car needs room behind the last one on its lane
+                const LaneState& lane = lanes[approach];
+                if (lane.size() == 0 || lane.distance.back() + params.upstream >= VehicleSize + params.driver.minGap)
+                {
+                    spawn(approach, -params.upstream);
+                    count++;
+                }
+            }
+        }
+
+        /// The first car that can still stop before a red stop line; it and every car behind it
+        /// halt there. Returns the lane size when the light is green or nobody can stop in time
+        std::size_t firstStopping(int approach, float& stopLine) const
+        {
+            const LaneState& lane = lanes[approach];
+            if (isGreen(approach))
+                return lane.size();
+
+            stopLine = enterDistance(approach) - 4.f;
+            for (std::size_t index = 0; index < lane.size(); index++)
+            {
+                float room = stopLine - lane.distance[index];
+                if (room >= lane.speed[index] * lane.speed[index] / (2.f * params.driver.hardBrake))
+                    return index;
+            }
+            return lane.size();
+        }
+
+        void move()
+        {
+            for (int approach = 0; approach < ApproachCount; approach++)
+            {
+                LaneState& lane = lanes[approach];
+                std::size_t count = lane.size();
+                float length = Lanes[approach].length;
+
+                if (params.exitRate > 0.f)
+                    lane.exitTokens = std::min(lane.exitTokens + params.exitRate / TicksPerSecond, 1.f);
+
+                lane.leaderRear.resize(count);
+                lane.leaderSpeed.resize(count);
+                if (count == 0)
+                    continue;
+
+                // Free road ahead of the first car, unless the road beyond the window is full
+                bool exitBlocked = params.exitRate > 0.f && lane.exitTokens < 1.f;
+                lane.leaderRear[0] = exitBlocked ? length : 1e9f;
+                lane.leaderSpeed[0] = exitBlocked ? 0.f : lane.desired[0];
+                for (std::size_t index = 1; index < count; index++)
+                {
+                    lane.leaderRear[index] = lane.distance[index - 1] - VehicleSize;
+                    lane.leaderSpeed[index] = lane.speed[index - 1];
+                }
+
+                // The first car that can still stop in time treats a red stop line as a standing car
+                float stopLine = 0.f;
+                std::size_t stopping = firstStopping(approach, stopLine);
+                if (stopping < count && stopLine < lane.leaderRear[stopping])
+                {
+                    lane.leaderRear[stopping] = stopLine;
+                    lane.leaderSpeed[stopping] = 0.f;
+                }
+
+                followLeaders(lane, params.driver);
+
+                std::size_t gone = 0;
+                while (gone < count && lane.distance[gone] > length)
+                    gone++;
+                if (gone > 0)
+                {
+                    lane.eraseFront(gone);
+                    result.exited += int(gone);
+                    if (params.exitRate > 0.f)
+                        lane.exitTokens -= float(gone);
+                }
+            }
+        }
+
+        /// The headless counterpart of collision(): a conflict table lookup for the
+        /// cars inside the box, then a check of the cells they cover
+        bool blocked()
+        {
+            inside.clear();
+            for (int approach = 0; approach < ApproachCount; approach++)
+            {
+                const LaneState& lane = lanes[approach];
+                float enter = enterDistance(approach) + params.collisionInset;
+
+                // Front-most first, so stop at the first car that has not reached the box
+                for (std::size_t index = 0; index < lane.size() && lane.distance[index] > enter; index++)
+                {
+                    Occupancy occupancy;
+                    occupancy.movement = lane.movements[index];
+                    occupancy.front = lane.distance[index] - enter;
+                    occupancy.rear = occupancy.front - VehicleSize + 2.f * params.collisionInset;
+                    if (occupancy.rear < routeLength(turnOf(occupancy.movement), BoxSize))
+                        inside.push_back(occupancy);
+                }
+            }
+
+            for (std::size_t i = 0; i < inside.size(); i++)
+            {
+                for (std::size_t j = i + 1; j < inside.size(); j++)
+                {
+                    if (conflicts(inside[i], inside[j], BoxSize))
+                        return true;
+                }
+            }
+            return false;
+        }
+
+        Parameters params;
+        Random random;
+        int tick;
+        int nextId;
+        LaneState lanes[ApproachCount];
+        std::vector<Occupancy> inside;
+        Forecast::Forecaster forecaster;
+        std::vector<Forecast::Mover> movers;
+        RunResult result;
+    };
+}
+
+#endif // SIMULATION_H
@@ -0,0 +1,245 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+// Uniform grid over axis aligned boxes. Entries are kept as a sorted list of
+// (cell, id) pairs, so rebuilding it every tick does not allocate once the
+// vectors have grown, and a query only looks at the cells it overlaps. A grid
+// that persists between ticks can instead update() the boxes that moved. Only
+// a box crossing into other cells adds entries, to a small sorted side list;
+// the entries it left go stale and are skipped, and once enough changes piled
+// up both lists are merged in one linear pass.
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+
+namespace Spatial
+{
+    struct Box
+    {
+        float left, top, width, height;
+
+        bool intersects(const Box& other) const
+        {
+            return left < other.left + other.width && other.left < left + width &&
+                   top < other.top + other.height && other.top < top + height;
+        }
+    };
+
+    class Grid
+    {
+    public:
+        explicit Grid(float cellSize) : cellSize(cellSize), stamp(0), stale(0) {}
+
+        void clear()
+        {
+            entries.clear();
+            added.clear();
+            boxes.clear();
+            present.clear();
+            sorted = true;
+            stale = 0;
+        }
+
+        /// Ids should be small and dense, they index the box table
+        void insert(int id, const Box& box)
+        {
+            grow(id);
+            boxes[id] = box;
+            present[id] = true;
+
+            int left = cell(box.left), right = cell(box.left + box.width);
+            int top = cell(box.top), bottom = cell(box.top + box.height);
+            for (int y = top; y <= bottom; y++)
+                for (int x = left; x <= right; x++)
+                    entries.push_back(Entry{ key(x, y), id });
+            sorted = false;
+        }
+
+        /// Inserts the id or moves its box
+        void update(int id, const Box& box)
+        {
+            grow(id);
+            Range before = present[id] ? range(boxes[id]) : Range{ 0, -1, 0, -1 };
+            Range after = range(box);
+            boxes[id] = box;
+            present[id] = true;
+            if (before == after)
+                return;
+
+            // Cells it keeps still have their entries, only the ones it enters need new ones
+            for (int y = after.top; y <= after.bottom; y++)
+                for (int x = after.left; x <= after.right; x++)
+                {
+                    if (!before.contains(x, y))
+                        added.push_back(Entry{ key(x, y), id });
+                }
+            stale += before.cells();
+            addedSorted = false;
+            settle();
+        }
+
+        /// Takes the id out until it is inserted or updated again
+        void remove(int id)
+        {
+            if (id >= int(boxes.size()) || !present[id])
+                return;
+            present[id] = false;
+            stale += range(boxes[id]).cells();
+            settle();
+        }
+
+        /// Ids whose box overlaps the area, each reported once
+        void query(const Box& area, std::vector<int>& out)
+        {
+            out.clear();
+            if (!sorted)
+            {
+                std::sort(entries.begin(), entries.end());
+                sorted = true;
+            }
+            if (!addedSorted)
+            {
+                std::sort(added.begin(), added.end());
+                addedSorted = true;
+            }
+            if (++stamp == 0)
+            {
+                std::fill(stamps.begin(), stamps.end(), 0);
+                stamp = 1;
+            }
+
+            int left = cell(area.left), right = cell(area.left + area.width);
+            int top = cell(area.top), bottom = cell(area.top + area.height);
+            for (int y = top; y <= bottom; y++)
+            {
+                collect(entries, area, key(left, y), key(right, y), out);
+                collect(added, area, key(left, y), key(right, y), out);
+            }
+        }
+
+        const Box& getBox(int id) const { return boxes[id]; }
+
+    private:
+        struct Entry
+        {
+            std::uint64_t key;
+            int id;
+
+            bool operator<(const Entry& other) const
+            {
+                return key < other.key || (key == other.key && id < other.id);
+            }
+        };
+
+        struct Range
+        {
+            int left, right, top, bottom;
+
+            bool operator==(const Range& other) const
+            {
+                return left == other.left && right == other.right && top == other.top && bottom == other.bottom;
+            }
+
+            bool contains(int x, int y) const
+            {
+                return x >= left && x <= right && y >= top && y <= bottom;
+            }
+
+            int cells() const
+            {
+                return (right - left + 1) * (bottom - top + 1);
+            }
+        };
+
+        /// Cells of one row are adjacent in a sorted list
+        void collect(const std::vector<Entry>& list, const Box& area, std::uint64_t first, std::uint64_t last, std::vector<int>& out)
+        {
+            std::vector<Entry>::const_iterator at = std::lower_bound(list.begin(), list.end(), Entry{ first, -1 });
+            for (; at != list.end() && at->key <= last; ++at)
+            {
+                if (stamps[at->id] != stamp && present[at->id] && boxes[at->id].intersects(area))
+                {
+                    stamps[at->id] = stamp;
+                    out.push_back(at->id);
+                }
+            }
+        }
+
+        /// An entry is live while its id is present and its cell is one the box covers
+        bool live(const Entry& entry) const
+        {
+            int x = int(std::uint32_t(entry.key) ^ 0x80000000u);
+            int y = int(std::uint32_t(entry.key >> 32) ^ 0x80000000u);
+            return present[entry.id] && range(boxes[entry.id]).contains(x, y);
+        }
+
+        /// Merges the side list in and drops stale entries once they make up a good share of the list
+        void settle()
+        {
+            if (added.size() + stale <= entries.size() / 4 + 64)
+                return;
+            if (!sorted)
+                std::sort(entries.begin(), entries.end());
+            if (!addedSorted)
+                std::sort(added.begin(), added.end());
+
+            merged.clear();
+            std::merge(entries.begin(), entries.end(), added.begin(), added.end(), std::back_inserter(merged));
+            entries.clear();
+            for (const Entry& entry : merged)
+            {
+                bool repeated = !entries.empty() && entries.back().key == entry.key && entries.back().id == entry.id;
+                if (!repeated && live(entry))
+                    entries.push_back(entry);
+            }
+            added.clear();
+            sorted = true;
+            addedSorted = true;
+            stale = 0;
+        }
+
+        void grow(int id)
+        {
+            if (id >= int(boxes.size()))
+            {
+                boxes.resize(id + 1);
+                stamps.resize(id + 1, 0);
+                present.resize(id + 1, false);
+            }
+        }
+
+        Range range(const Box& box) const
+        {
+            Range cells = { cell(box.left), cell(box.left + box.width), cell(box.top), cell(box.top + box.height) };
+            return cells;
+        }
+
+        int cell(float coordinate) const
+        {
+            return int(std::floor(coordinate / cellSize));
+        }
+
+        /// Row major with an offset, so negative cells sort before positive ones
+        static std::uint64_t key(int x, int y)
+        {
+            return (std::uint64_t(std::uint32_t(y) ^ 0x80000000u) << 32) | (std::uint32_t(x) ^ 0x80000000u);
+        }
+
+        float cellSize;
+        std::vector<Entry> entries;
+        std::vector<Entry> added;   // entries of cells that update() moved boxes into
+        std::vector<Entry> merged;
+        std::vector<Box> boxes;
+        std::vector<unsigned> stamps;
+        std::vector<bool> present;
+        unsigned stamp;
+        std::size_t stale;          // entries left behind by moved or removed boxes
+        bool sorted = true;
+        bool addedSorted = true;
+    };
+}
+
+#endif // SPATIALGRID_H
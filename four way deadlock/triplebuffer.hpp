@@ -0,0 +1,58 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+// Lock free hand over of whole values from one writer thread to one reader
+// thread. The writer fills its back slot and swaps it with the middle one,
+// the reader swaps its front slot with the middle one whenever a fresh value
+// is waiting there. Neither side ever waits for the other: the reader always
+// has the newest complete value, and values it was too slow for are skipped.
+
+#include <atomic>
+#include <cstdint>
+
+template <class T>
+class TripleBuffer
+{
+    public:
+        TripleBuffer() : front(0), back(2), middle(1), skipped(0) {}
+
+        /// Writer side, the slot to fill before the next publish()
+        T& write() { return slots[back]; }
+
+        /// Writer side, makes the filled slot the newest value
+        void publish()
+        {
+            unsigned old = middle.exchange(back | Fresh, std::memory_order_acq_rel);
+            back = old & Index;
+            if (old & Fresh)
+                skipped.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// Reader side, switches to the newest value; false if nothing was published since the last call
+        bool update()
+        {
+            if (!(middle.load(std::memory_order_relaxed) & Fresh))
+                return false;
+            front = middle.exchange(front, std::memory_order_acq_rel) & Index;
+            return true;
+        }
+
+        /// Reader side, stays valid and unchanged until the next update()
+        const T& read() const { return slots[front]; }
+        T& read() { return slots[front]; }
+
+        /// Values replaced before the reader got to see them
+        std::uint64_t getSkipped() const { return skipped.load(std::memory_order_relaxed); }
+
+    private:
+        static const unsigned Index = 3;
+        static const unsigned Fresh = 4;
+
+        T slots[3];
+        alignas(64) unsigned front; // owned by the reader
+        alignas(64) unsigned back;  // owned by the writer
+        alignas(64) std::atomic<unsigned> middle;
+        std::atomic<std::uint64_t> skipped;
+};
+
+#endif // TRIPLEBUFFER_H